@@ -0,0 +1,96 @@
+#include "Results.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+
+// names and units are identifiers from bench.cpp, nothing to escape
+bool writeResults(const std::string &path, const std::vector<Metric> &metrics)
+{
+    std::FILE *file = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    std::fprintf(file, "{\n  \"benchmark\": \"lensing2d\",\n  \"metrics\": [\n");
+    for (size_t i = 0; i < metrics.size(); ++i)
+    {
+        const Metric &metric = metrics[i];
+        std::fprintf(file, "    {\"scenario\": \"%s\", \"name\": \"%s\", \"value\": %.9g, \"unit\": \"%s\", \"better\": \"%s\"}%s\n",
+                     metric.scenario.c_str(), metric.name.c_str(), metric.value, metric.unit.c_str(),
+                     metric.higherIsBetter ? "higher" : "lower", i + 1 < metrics.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+
+    bool written = !std::ferror(file);
+    if (file == stdout) return std::fflush(file) == 0 && written;
+    return std::fclose(file) == 0 && written;
+}
+
+// the string after "key": on the line, empty if absent
+static std::string stringField(const std::string &line, const std::string &key)
+{
+    std::string pattern = "\"" + key + "\": \"";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos) return "";
+    start += pattern.size();
+    size_t end = line.find('"', start);
+    return end == std::string::npos ? "" : line.substr(start, end - start);
+}
+
+bool readResults(const std::string &path, std::vector<Metric> &metrics)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    // the layout of writeResults : a metric is a line with a scenario
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::string scenario = stringField(line, "scenario");
+        size_t value = line.find("\"value\": ");
+        if (scenario.empty() || value == std::string::npos) continue;
+        Metric metric;
+        metric.scenario = scenario;
+        metric.name = stringField(line, "name");
+        metric.value = std::strtod(line.c_str() + value + 9, nullptr);
+        metric.unit = stringField(line, "unit");
+        metric.higherIsBetter = stringField(line, "better") == "higher";
+        metrics.push_back(metric);
+    }
+    return true;
+}
+
+int compareResults(const std::vector<Metric> &baseline, const std::vector<Metric> &current, double threshold)
+{
+    std::map<std::pair<std::string, std::string>, const Metric *> before;
+    for (const Metric &metric : baseline) before[{metric.scenario, metric.name}] = &metric;
+
+    int regressions = 0;
+    std::printf("%-22s %-28s %14s %14s %9s\n", "scenario", "metric", "baseline", "current", "change");
+    for (const Metric &metric : current)
+    {
+        auto found = before.find({metric.scenario, metric.name});
+        if (found == before.end() || found->second->value == 0.0) continue;
+
+        // positive when better, whichever way the metric goes
+        double change = (metric.value - found->second->value) / std::fabs(found->second->value);
+        double gain = metric.higherIsBetter ? change : -change;
+        const char *flag = "";
+        if (gain < -threshold)
+        {
+            flag = "  REGRESSION";
+            regressions++;
+        }
+        else if (gain > threshold)
+        {
+            flag = "  improved";
+        }
+        std::printf("%-22s %-28s %14.6g %14.6g %+8.1f%%%s\n", metric.scenario.c_str(), metric.name.c_str(),
+                    found->second->value, metric.value, 100.0 * change, flag);
+    }
+    std::printf("%d regression%s beyond %.1f%%\n", regressions, regressions == 1 ? "" : "s", 100.0 * threshold);
+    return regressions;
+}
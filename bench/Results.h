@@ -0,0 +1,27 @@
+#ifndef BENCH_RESULTS_H
+#define BENCH_RESULTS_H
+
+#include <string>
+#include <vector>
+
+// one measured value of a scenario
+struct Metric
+{
+    std::string scenario;
+    std::string name;
+    double value;
+    std::string unit;
+    bool higherIsBetter; // throughputs go up, times and memory go down
+};
+
+// the results as JSON, one metric per line so the files diff well
+bool writeResults(const std::string &path, const std::vector<Metric> &);
+
+// read a file written by writeResults, false if it can't be read
+bool readResults(const std::string &path, std::vector<Metric> &);
+
+// print the metrics found in both runs with their relative change, and return the
+//      number of regressions : metrics worse by more than the threshold (0.05 is 5 %)
+int compareResults(const std::vector<Metric> &baseline, const std::vector<Metric> &current, double threshold);
+
+#endif
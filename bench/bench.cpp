@@ -0,0 +1,394 @@
+// scenario benchmarks of the simulation, the ECS and the CPU trail renderer.
+//      Writes the measures as JSON, and compares two result files to catch regressions :
+//
+//      bench [--output results.json|-] [--filter NAME]
+//      bench --compare baseline.json current.json [--threshold 0.05]
+//
+//      No GL context is created, the trail scenario draws with the software rasterizer
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "../components/Color.h"
+#include "../components/GravityWell.h"
+#include "../components/Projectile.h"
+#include "../components/Spherical.h"
+#include "../components/Trail.h"
+#include "../components/Transform2D.h"
+#include "../components/Velocity2D.h"
+#include "../core/Coordinator.h"
+#include "../core/SoftwareRasterizer.h"
+#include "../core/ThreadPool.h"
+#include "../systems/LensingSystem.h"
+#include "../systems/RenderSnapshot.h"
+#include "../systems/RenderSpheresSystem.h"
+#include "../systems/RenderTrailSystem.h"
+#include "Results.h"
+
+// the systems reference the global coordinator, like in lensing2d.cpp
+Coordinator coordinator;
+
+// the scene of lensing2d.cpp : world half extents, black hole mass and time step
+static const float WORLD_HALF_WIDTH = 1e11f;
+static const float WORLD_HALF_HEIGHT = 7.5e10f;
+static const float BLACK_HOLE_MASS = 8.54e36f;
+static const float TIME_STEP = 1.5f;
+static const int IMAGE_WIDTH = 800;
+static const int IMAGE_HEIGHT = 600;
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// start measuring the memory high-water mark from the current resident size, after
+//      handing the previous scenario's free memory back. Linux only, elsewhere the mark
+//      stays the one of the whole process
+static void resetPeakMemory()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+// highest resident memory since resetPeakMemory, in KiB
+static double peakMemoryKiB()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::atof(line.c_str() + 6);
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss);
+}
+
+// the ECS of a scenario, built from scratch
+struct World
+{
+    std::shared_ptr<LensingSystem> lensing;
+    std::shared_ptr<RenderSpheresSystem> spheres;
+    std::shared_ptr<RenderTrailSystem> trails;
+    std::shared_ptr<TrailArena> arena;
+    size_t rayCount = 0;
+};
+
+// the components and systems of lensing2d.cpp, wellCount black holes (the first one at
+//      the origin) and a column of rayCount rays on the left edge going right
+static World createWorld(size_t rayCount, size_t wellCount)
+{
+    coordinator.init();
+    coordinator.registerComponent<Spherical>();
+    coordinator.registerComponent<Color>();
+    coordinator.registerComponent<Transform2D>();
+    coordinator.registerComponent<GravityWell>();
+    coordinator.registerComponent<Projectile>();
+    coordinator.registerComponent<Velocity2D>();
+    coordinator.registerComponent<Trail>();
+
+    World world;
+    world.rayCount = rayCount;
+    world.spheres = coordinator.registerSystem<RenderSpheresSystem>();
+    {
+        Signature signature;
+        signature.set(coordinator.getComponentType<Transform2D>());
+        signature.set(coordinator.getComponentType<Spherical>());
+        signature.set(coordinator.getComponentType<GravityWell>());
+        coordinator.setSystemSignature<RenderSpheresSystem>(signature);
+    }
+    world.trails = coordinator.registerSystem<RenderTrailSystem>();
+    {
+        Signature signature;
+        signature.set(coordinator.getComponentType<Transform2D>());
+        signature.set(coordinator.getComponentType<Trail>());
+        signature.set(coordinator.getComponentType<Color>());
+        coordinator.setSystemSignature<RenderTrailSystem>(signature);
+    }
+    world.lensing = coordinator.registerSystem<LensingSystem>();
+    {
+        Signature signature;
+        signature.set(coordinator.getComponentType<Transform2D>());
+        coordinator.setSystemSignature<LensingSystem>(signature);
+    }
+
+    // same trail settings as the window
+    world.arena = std::make_shared<TrailArena>(64);
+    TrailDecimation decimation;
+    decimation.tolerance = 0.25f * 2.0f * WORLD_HALF_WIDTH / IMAGE_WIDTH;
+    decimation.maxLength = 200 * TIME_STEP * c;
+    world.arena->setDecimation(decimation);
+    world.trails->setTrailArena(world.arena);
+    world.lensing->setTrailArena(world.arena);
+
+    const float rs = 2.0f * G * BLACK_HOLE_MASS / (c * c);
+    for (size_t i = 0; i < wellCount; ++i)
+    {
+        // the others on a ring around the first one
+        float angle = 2.0f * float(M_PI) * i / std::max<size_t>(wellCount - 1, 1);
+        glm::vec2 position = i == 0 ? glm::vec2(0.0f) : 0.5f * WORLD_HALF_HEIGHT * glm::vec2(std::cos(angle), std::sin(angle));
+        Entity well = coordinator.createEntity();
+        coordinator.addComponent<Transform2D>(well, {position});
+        coordinator.addComponent<Spherical>(well, {rs});
+        coordinator.addComponent<Color>(well, {glm::vec4(1.0f, 0.2f, 0.2f, 1.0f)});
+        coordinator.addComponent<GravityWell>(well, {BLACK_HOLE_MASS, rs});
+    }
+
+    std::vector<Entity> rays = coordinator.createEntities(rayCount);
+    std::vector<Transform2D> positions(rayCount);
+    std::vector<Velocity2D> velocities(rayCount, {glm::vec2(c, 0.0f)});
+    std::vector<Projectile> projectiles(rayCount);
+    std::vector<Color> colors(rayCount, {glm::vec4(1, 1, 0, 1)});
+    std::vector<Trail> trails(rayCount);
+    world.arena->reserve(static_cast<std::uint32_t>(rayCount));
+    const float yStep = rayCount > 1 ? 2.0f * WORLD_HALF_HEIGHT / float(rayCount - 1) : 0.0f;
+    for (size_t i = 0; i < rayCount; ++i)
+    {
+        trails[i] = world.arena->allocate();
+        float y = -WORLD_HALF_HEIGHT + i * yStep;
+        positions[i].position = glm::vec2(-WORLD_HALF_WIDTH, y);
+        projectiles[i].impactParameter = std::fabs(y);
+    }
+    coordinator.addComponents(rays, positions, velocities, projectiles, colors, trails);
+    return world;
+}
+
+static void simulate(World &world, int updates)
+{
+    for (int i = 0; i < updates; ++i)
+    {
+        world.lensing->update(TIME_STEP);
+        coordinator.flushCommands();
+    }
+}
+
+// the lensing update alone : throughput in rays x updates per second
+static void benchSimulation(const std::string &scenario, size_t rayCount, size_t wellCount, int updates,
+                            std::vector<Metric> &metrics, GeodesicIntegrator integrator = GeodesicIntegrator::Full)
+{
+    World world = createWorld(rayCount, wellCount);
+    world.lensing->setIntegrator(integrator);
+    Clock::time_point start = Clock::now();
+    simulate(world, updates);
+    double seconds = secondsSince(start);
+
+    metrics.push_back({scenario, "ray_steps_per_second", rayCount * double(updates) / seconds, "1/s", true});
+    metrics.push_back({scenario, "update_ms", 1e3 * seconds / updates, "ms", false});
+    metrics.push_back({scenario, "peak_memory", peakMemoryKiB(), "KiB", false});
+}
+
+// a long trail on every ray, captured and drawn by the CPU rasterizer each frame
+static void benchTrailRender(const std::string &scenario, size_t rayCount, int warmUp, int frames,
+                             std::vector<Metric> &metrics)
+{
+    World world = createWorld(rayCount, 1);
+    simulate(world, warmUp);
+
+    ThreadPool pool(ThreadPool::defaultWorkerCount());
+    SoftwareRasterizer rasterizer(IMAGE_WIDTH, IMAGE_HEIGHT);
+    rasterizer.setProjection(glm::ortho(-WORLD_HALF_WIDTH, WORLD_HALF_WIDTH, -WORLD_HALF_HEIGHT, WORLD_HALF_HEIGHT, -1.0f, 1.0f));
+    RenderSnapshot snapshot;
+    double captureSeconds = 0.0;
+    double drawSeconds = 0.0;
+    double points = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        simulate(world, 1);
+
+        Clock::time_point start = Clock::now();
+        world.spheres->captureCircles(snapshot.circles);
+        world.trails->captureTrails(snapshot.trails);
+        captureSeconds += secondsSince(start);
+
+        start = Clock::now();
+        rasterizer.clear(glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
+        world.spheres->rasterizeCircles(snapshot.circles, rasterizer);
+        world.trails->rasterizeTrails(snapshot.trails, rasterizer);
+        rasterizer.render(pool);
+        drawSeconds += secondsSince(start);
+
+        for (const Trail &trail : snapshot.trails.trails) points += trail.count;
+    }
+
+    metrics.push_back({scenario, "capture_ms", 1e3 * captureSeconds / frames, "ms", false});
+    metrics.push_back({scenario, "rasterize_ms", 1e3 * drawSeconds / frames, "ms", false});
+    metrics.push_back({scenario, "trail_points_per_ray", points / (double(frames) * rayCount), "points", false});
+    metrics.push_back({scenario, "peak_memory", peakMemoryKiB(), "KiB", false});
+}
+
+// the integrator alone, on a ray circling near the photon sphere
+static void benchRk4Step(const std::string &scenario, GeodesicIntegrator integrator, std::vector<Metric> &metrics)
+{
+    LensingSystem lensing;
+    const float rs = 2.0f * G * BLACK_HOLE_MASS / (c * c);
+    GeodesicState initial{1.5f * rs, 0.0f, 0.0f, c / (1.5f * rs), 0.0f, 0.0f};
+    LensingSystem::computeConserved(initial, rs);
+    const float dl = TIME_STEP / 8.0f;
+    const int steps = 10000000;
+
+    GeodesicState state = initial;
+    volatile float sink = 0.0f;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < steps; ++i)
+    {
+        if (integrator == GeodesicIntegrator::Reduced) lensing.rk4StepReduced(state, dl, rs);
+        else lensing.rk4Step(state, dl, rs);
+        // restart a ray that left the orbit before it turns into inf or nan
+        if (!(state.r > rs && state.r < 100.0f * rs)) state = initial;
+    }
+    sink = sink + state.r;
+    double seconds = secondsSince(start);
+
+    metrics.push_back({scenario, "rk4_step_ns", 1e9 * seconds / steps, "ns", false});
+}
+
+// cost per entity of the structural ECS operations
+static void benchEcs(const std::string &scenario, std::vector<Metric> &metrics)
+{
+    const size_t count = 100000;
+    createWorld(0, 0);
+
+    auto measure = [&](const std::string &name, const std::function<void()> &operation) {
+        Clock::time_point start = Clock::now();
+        operation();
+        metrics.push_back({scenario, name, 1e9 * secondsSince(start) / count, "ns", false});
+    };
+
+    std::vector<Entity> entities;
+    measure("create_entity_ns", [&] {
+        for (size_t i = 0; i < count; ++i) entities.push_back(coordinator.createEntity());
+    });
+    measure("add_component_ns", [&] {
+        for (Entity e : entities) coordinator.addComponent<Transform2D>(e, {glm::vec2(1.0f)});
+    });
+    float sum = 0.0f;
+    measure("get_component_ns", [&] {
+        for (Entity e : entities) sum += coordinator.getComponent<Transform2D>(e).position.x;
+    });
+    measure("has_component_ns", [&] {
+        for (Entity e : entities) sum += coordinator.hasComponent<Velocity2D>(e) ? 1.0f : 0.0f;
+    });
+    measure("destroy_entity_ns", [&] {
+        for (Entity e : entities) coordinator.destroyEntity(e);
+    });
+    measure("bulk_create_ns", [&] {
+        std::vector<Entity> batch = coordinator.createEntities(count);
+        std::vector<Transform2D> positions(count);
+        std::vector<Velocity2D> velocities(count);
+        coordinator.addComponents(batch, positions, velocities);
+        entities = batch;
+    });
+    measure("command_buffer_ns", [&] {
+        CommandBuffer &commands = coordinator.getCommandBuffer();
+        for (Entity e : entities) commands.destroyEntity(e);
+        for (size_t i = 0; i < count; ++i)
+        {
+            Entity e = commands.createEntity();
+            commands.addComponent<Transform2D>(e, {glm::vec2(2.0f)});
+        }
+        coordinator.flushCommands();
+    });
+
+    volatile float sink = sum;
+    (void)sink;
+}
+
+struct Scenario
+{
+    std::string name;
+    std::function<void(std::vector<Metric> &)> run;
+};
+
+static void printUsage(const char *program)
+{
+    std::cerr << "usage: " << program << " [--output FILE|-] [--filter NAME]\n"
+              << "       " << program << " --compare BASELINE CURRENT [--threshold FRACTION]\n"
+              << "  --output FILE       JSON results (default -, stdout)\n"
+              << "  --filter NAME       only the scenarios whose name contains NAME\n"
+              << "  --compare A B       list the changes from A to B, exit status 1 on regressions\n"
+              << "  --threshold F       relative change counted as a regression (default 0.05)\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string output = "-";
+    std::string filter;
+    std::string baselinePath, currentPath;
+    double threshold = 0.05;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--output" && hasValue) output = argv[++i];
+        else if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--threshold" && hasValue) threshold = std::atof(argv[++i]);
+        else if (arg == "--compare" && i + 2 < argc)
+        {
+            baselinePath = argv[++i];
+            currentPath = argv[++i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!baselinePath.empty())
+    {
+        std::vector<Metric> baseline, current;
+        if (!readResults(baselinePath, baseline) || !readResults(currentPath, current))
+        {
+            std::cerr << "Failed to read " << baselinePath << " or " << currentPath << std::endl;
+            return EXIT_FAILURE;
+        }
+        return compareResults(baseline, current, threshold) > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // updates per sweep scaled so each one takes about as long
+    const std::vector<Scenario> scenarios = {
+        {"ecs_ops", [](std::vector<Metric> &m) { benchEcs("ecs_ops", m); }},
+        {"rk4_step", [](std::vector<Metric> &m) { benchRk4Step("rk4_step", GeodesicIntegrator::Full, m); }},
+        {"rk4_reduced_step", [](std::vector<Metric> &m) { benchRk4Step("rk4_reduced_step", GeodesicIntegrator::Reduced, m); }},
+        {"default_100", [](std::vector<Metric> &m) { benchSimulation("default_100", 100, 1, 600, m); }},
+        {"sweep_10k", [](std::vector<Metric> &m) { benchSimulation("sweep_10k", 10000, 1, 200, m); }},
+        {"sweep_100k", [](std::vector<Metric> &m) { benchSimulation("sweep_100k", 100000, 1, 20, m); }},
+        {"sweep_100k_block", [](std::vector<Metric> &m) { benchSimulation("sweep_100k_block", 100000, 1, 20, m, GeodesicIntegrator::Block); }},
+        {"sweep_1m", [](std::vector<Metric> &m) { benchSimulation("sweep_1m", 1000000, 1, 3, m); }},
+        {"multi_well_16", [](std::vector<Metric> &m) { benchSimulation("multi_well_16", 10000, 16, 200, m); }},
+        {"trail_render_10k", [](std::vector<Metric> &m) { benchTrailRender("trail_render_10k", 10000, 200, 60, m); }},
+    };
+
+    std::vector<Metric> metrics;
+    for (const Scenario &scenario : scenarios)
+    {
+        if (scenario.name.find(filter) == std::string::npos) continue;
+        std::cerr << "running " << scenario.name << std::endl;
+        resetPeakMemory();
+        scenario.run(metrics);
+    }
+
+    if (!writeResults(output, metrics))
+    {
+        std::cerr << "Failed to write " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
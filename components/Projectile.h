@@ -4,6 +4,11 @@
 struct Projectile
 {
     float impactParameter;
+
+    // conserved energy and angular momentum around the lensing well, taken at launch by
+    //      the reduced integrator of LensingSystem. E stays 0 until then
+    float E = 0.0f;
+    float L = 0.0f;
 };
 
 #endif
\ No newline at end of file
@@ -2,11 +2,208 @@
 #define COMPONENTS_TRAIL_H
 
 #include <vector>
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
 #include <glm/glm.hpp>
 
+// allocator whose resize leaves new elements default-initialised, so uninitialised
+//      for plain types : growing the arena by a million rings doesn't write hundreds
+//      of MB of zeros nobody reads, a ring's points are only read once pushed
+template <class T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <class U>
+    struct rebind { using other = DefaultInitAllocator<U>; };
 
+    DefaultInitAllocator() = default;
+    template <class U>
+    DefaultInitAllocator(const DefaultInitAllocator<U> &) {}
+
+    template <class U>
+    void construct(U *p) { ::new (static_cast<void *>(p)) U; }
+    template <class U, class... Args>
+    void construct(U *p, Args &&...args) { ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+};
+
+using TrailPoints = std::vector<glm::vec3, DefaultInitAllocator<glm::vec3>>;
+
+// history of a ray's positions, a fixed-capacity ring buffer living in a TrailArena
+//      once the ring is full the newest point overwrites the oldest one.
+//      A point is x, y and in z the length of the trail up to it
 struct Trail {
-    std::vector<glm::vec3> trail;
+    std::uint32_t slot;  // which ring of the arena belongs to the ray
+    std::uint32_t head;  // index in the ring where the next point goes
+    std::uint32_t count; // number of valid points, up to the arena ring length
+    std::uint32_t total; // points pushed since the ring was allocated, lets readers catch up
+
+    // decimation state, see TrailArena::record
+    glm::vec2 lastSample{0.0f};  // newest recorded position, kept only if the next one needs it
+    float wedgeBase = 0.0f;      // direction from the newest point to the first sample past the tolerance
+    float wedgeLow = 0.0f;       // directions from the newest point, relative to wedgeBase, whose
+    float wedgeHigh = 0.0f;      //      line passes within the tolerance of every sample since
+    bool wedgeOpen = false;      // false while every sample is within the tolerance of the newest point
+};
+
+// how recorded positions become trail points
+struct TrailDecimation {
+    float tolerance = 0.0f;  // largest distance between a dropped position and the trail, 0 keeps them all
+    float maxTurn = 0.1f;    // largest direction change in radians between two points, near the newest one
+    float maxLength = 0.0f;  // trail length kept behind the head, 0 for up to the ring length
+};
+
+// one contiguous block holding the rings of every trail, back to back
+//      ring k occupies points [k * ringLength, (k + 1) * ringLength).
+//      Rings are handed out once per ray, appending a point is O(1) and never allocates
+class TrailArena {
+public:
+    explicit TrailArena(std::uint32_t ringLength = 200) : ringLength(ringLength) {}
+
+    // number of points a trail keeps
+    std::uint32_t getRingLength() const { return ringLength; }
+
+    // make room for the given number of rings, so allocating them does not move the block
+    void reserve(std::uint32_t rings) { points.reserve(static_cast<size_t>(rings) * ringLength); }
+
+    // a new empty trail with a ring of its own, reusing released rings first
+    Trail allocate();
+
+    // give the ring of a retired trail back to the arena
+    void release(const Trail &trail) { freeSlots.push_back(trail.slot); }
+
+    // append a point, overwriting the oldest one when the ring is full
+    void push(Trail &, glm::vec3 point);
+
+    // record the ray's new position. Online decimation : a position is kept only once a
+    //      later one can't be reached by a straight line from the newest point passing
+    //      within the tolerance of every position in between, or turning more than maxTurn.
+    //      The directions that qualify form a wedge narrowed by each position, so this is
+    //      O(1) per position, without keeping the dropped ones.
+    //      Then the points wholly past maxLength behind the position are dropped
+    void record(Trail &, glm::vec2 position);
+
+    void setDecimation(const TrailDecimation &settings) { decimation = settings; }
+    const TrailDecimation &getDecimation() const { return decimation; }
+
+    // trail length from its first point to the given head position
+    float headLength(const Trail &trail, glm::vec2 head) const
+    {
+        const glm::vec3 &newest = at(trail, trail.count - 1);
+        return newest.z + glm::distance(glm::vec2(newest), head);
+    }
+
+    // i-th point of the trail, 0 is the oldest and count - 1 the newest
+    const glm::vec3 &at(const Trail &trail, std::uint32_t i) const
+    {
+        assert(i < trail.count && "Trail point out of range");
+        return points[static_cast<size_t>(trail.slot) * ringLength + ringIndex(trail, i)];
+    }
+
+    // the whole point block, ring by ring. Points not pushed yet are left unset
+    const TrailPoints &data() const { return points; }
+
+    // number of rings handed out so far, released ones included
+    std::uint32_t getRingCount() const { return static_cast<std::uint32_t>(points.size() / ringLength); }
+
+    // index in the ring of the i-th point, 0 is the oldest
+    std::uint32_t ringIndex(const Trail &trail, std::uint32_t i) const
+    {
+        std::uint32_t index = trail.head + ringLength - trail.count + i;
+        return index >= ringLength ? index - ringLength : index;
+    }
+
+private:
+    std::uint32_t ringLength;
+    TrailPoints points;
+    std::vector<std::uint32_t> freeSlots;
+    TrailDecimation decimation;
+
+    // start a new wedge at the newest point, towards position
+    void openWedge(Trail &, glm::vec2 position) const;
+
+    // half width of the wedge of directions passing within the tolerance of a position that far
+    float wedgeHalfWidth(float distance) const
+    {
+        return std::min(std::asin(std::min(1.0f, decimation.tolerance / distance)), decimation.maxTurn);
+    }
 };
 
-#endif
\ No newline at end of file
+inline Trail TrailArena::allocate()
+{
+    if (!freeSlots.empty())
+    {
+        std::uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return Trail{slot, 0, 0, 0, glm::vec2(0.0f), 0.0f, 0.0f, 0.0f, false};
+    }
+    std::uint32_t slot = static_cast<std::uint32_t>(points.size() / ringLength);
+    points.resize(points.size() + ringLength);
+    return Trail{slot, 0, 0, 0, glm::vec2(0.0f), 0.0f, 0.0f, 0.0f, false};
+}
+
+inline void TrailArena::push(Trail &trail, glm::vec3 point)
+{
+    points[static_cast<size_t>(trail.slot) * ringLength + trail.head] = point;
+    trail.head = (trail.head + 1 == ringLength) ? 0 : trail.head + 1;
+    if (trail.count < ringLength) trail.count++;
+    trail.total++;
+}
+
+inline void TrailArena::openWedge(Trail &trail, glm::vec2 position) const
+{
+    glm::vec2 offset = position - glm::vec2(at(trail, trail.count - 1));
+    float distance = glm::length(offset);
+    trail.wedgeOpen = distance > decimation.tolerance;
+    if (!trail.wedgeOpen) return;
+    float halfWidth = wedgeHalfWidth(distance);
+    trail.wedgeBase = std::atan2(offset.y, offset.x);
+    trail.wedgeLow = -halfWidth;
+    trail.wedgeHigh = halfWidth;
+}
+
+inline void TrailArena::record(Trail &trail, glm::vec2 position)
+{
+    if (trail.count == 0 || decimation.tolerance <= 0.0f)
+    {
+        float length = trail.count == 0 ? 0.0f : headLength(trail, position);
+        push(trail, glm::vec3(position, length));
+    }
+    else if (!trail.wedgeOpen)
+    {
+        openWedge(trail, position);
+    }
+    else
+    {
+        glm::vec2 offset = position - glm::vec2(at(trail, trail.count - 1));
+        float distance = glm::length(offset);
+        float direction = std::atan2(offset.y, offset.x) - trail.wedgeBase;
+        if (direction > float(M_PI)) direction -= 2.0f * float(M_PI);
+        else if (direction <= -float(M_PI)) direction += 2.0f * float(M_PI);
+
+        if (direction < trail.wedgeLow || direction > trail.wedgeHigh)
+        {
+            // no line from the newest point fits this position as well : the previous one is kept
+            push(trail, glm::vec3(trail.lastSample, headLength(trail, trail.lastSample)));
+            openWedge(trail, position);
+        }
+        else
+        {
+            float halfWidth = wedgeHalfWidth(distance);
+            trail.wedgeLow = std::max(trail.wedgeLow, direction - halfWidth);
+            trail.wedgeHigh = std::min(trail.wedgeHigh, direction + halfWidth);
+        }
+    }
+    trail.lastSample = position;
+
+    // keep a single point before the length limit, the renderers cut its segment there
+    if (decimation.maxLength > 0.0f)
+    {
+        float cutoff = headLength(trail, position) - decimation.maxLength;
+        while (trail.count >= 2 && at(trail, 1).z <= cutoff) trail.count--;
+    }
+}
+
+#endif
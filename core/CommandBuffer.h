@@ -0,0 +1,174 @@
+#ifndef CORE_COMMAND_BUFFER_H
+#define CORE_COMMAND_BUFFER_H
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+
+#include "Entity.h"
+#include "Component.h"
+#include "ComponentManager.h"
+
+// entities created through a command buffer get a placeholder handle with this bit set
+//      until the buffer is flushed and a real entity is allocated. Real handles never
+//      have it since generations stay below MAX_GENERATION
+const Entity PENDING_ENTITY_BIT = Entity(1) << 63;
+
+// interface for the recorded component values so the flush can handle
+//      every component type through the same pointer
+class InterfaceCommandPayload
+{
+public:
+    virtual ~InterfaceCommandPayload() = default;
+
+    // insert the recorded values[indices[i]] as the component of entities[i], in one batch
+    virtual void insertInto(ComponentManager &, const Entity *entities, const std::uint32_t *indices, size_t count) = 0;
+
+    // overwrite the component of an entity that already has one
+    virtual void assignTo(ComponentManager &, Entity, std::uint32_t index) = 0;
+
+    // forget every recorded value
+    virtual void clear() = 0;
+};
+
+// the recorded values of component T
+template <class T>
+class CommandPayload : public InterfaceCommandPayload
+{
+public:
+    std::uint32_t push(T value)
+    {
+        values.push_back(std::move(value));
+        return static_cast<std::uint32_t>(values.size() - 1);
+    }
+
+    void insertInto(ComponentManager &componentManager, const Entity *entities, const std::uint32_t *indices, size_t count) override
+    {
+        // gather the values in entity order so the component array gets one bulk insert
+        std::vector<T> batch;
+        batch.reserve(count);
+        for (size_t i = 0; i < count; ++i) batch.push_back(std::move(values[indices[i]]));
+        componentManager.addComponents<T>(entities, batch.data(), count);
+    }
+
+    void assignTo(ComponentManager &componentManager, Entity entity, std::uint32_t index) override
+    {
+        componentManager.getComponent<T>(entity) = std::move(values[index]);
+        componentManager.markChanged<T>(entity);
+    }
+
+    void clear() override { values.clear(); }
+
+private:
+    std::vector<T> values;
+};
+
+// records structural changes (create, destroy, add and remove component) so they can
+//      be requested while a system iterates its entities or from a worker thread.
+//      Nothing touches the ECS until Coordinator::flushCommands() applies every
+//      buffer at a sync point. Each thread records into its own buffer so no lock is needed.
+class CommandBuffer
+{
+public:
+    explicit CommandBuffer(ComponentManager *componentManager) : componentManager(componentManager) {}
+
+    // reserve a new entity, the returned placeholder can be used by the
+    //      following commands of this buffer
+    Entity createEntity();
+
+    // destroy an entity at the next flush
+    void destroyEntity(Entity);
+
+    // associate a component to an entity at the next flush
+    //      if the entity already has one, its value is overwritten
+    template <typename T>
+    void addComponent(Entity, T);
+
+    // un-associate a component from an entity at the next flush
+    template <typename T>
+    void removeComponent(Entity);
+
+    bool empty() const { return commands.empty() && createdCount == 0; }
+
+private:
+    friend class Coordinator;
+
+    enum class CommandKind : std::uint8_t
+    {
+        Destroy,
+        Add,
+        Remove
+    };
+
+    struct Command
+    {
+        Entity entity;              // real id or placeholder
+        CommandKind kind;
+        ComponentType type;         // for Add and Remove
+        std::uint32_t payloadIndex; // for Add, index in payloads[type]
+    };
+
+    ComponentManager *componentManager;
+
+    // the commands in recording order
+    std::vector<Command> commands;
+
+    // number of placeholders handed out since the last flush
+    std::uint32_t createdCount = 0;
+
+    // recorded component values, one payload per component type
+    std::array<std::unique_ptr<InterfaceCommandPayload>, MAX_COMPONENTS> payloads;
+
+    // forget everything once applied
+    void clear();
+
+    // record for another world. Its component types may be numbered differently, so
+    //      the payloads are dropped and made again for the new types
+    void reset(ComponentManager *);
+};
+
+inline Entity CommandBuffer::createEntity()
+{
+    return PENDING_ENTITY_BIT | createdCount++;
+}
+
+inline void CommandBuffer::destroyEntity(Entity entity)
+{
+    commands.push_back({entity, CommandKind::Destroy, 0, 0});
+}
+
+inline void CommandBuffer::clear()
+{
+    commands.clear();
+    createdCount = 0;
+    for (auto &payload : payloads)
+    {
+        if (payload) payload->clear();
+    }
+}
+
+inline void CommandBuffer::reset(ComponentManager *manager)
+{
+    clear();
+    for (auto &payload : payloads) payload.reset();
+    componentManager = manager;
+}
+
+template <typename T>
+void CommandBuffer::addComponent(Entity entity, T component)
+{
+    ComponentType type = componentManager->getComponentType<T>();
+    if (!payloads[type]) payloads[type] = std::make_unique<CommandPayload<T>>();
+    std::uint32_t index = static_cast<CommandPayload<T> *>(payloads[type].get())->push(std::move(component));
+    commands.push_back({entity, CommandKind::Add, type, index});
+}
+
+template <typename T>
+void CommandBuffer::removeComponent(Entity entity)
+{
+    commands.push_back({entity, CommandKind::Remove, componentManager->getComponentType<T>(), 0});
+}
+
+#endif
@@ -16,6 +16,10 @@ const ComponentType MAX_COMPONENTS = 32;
 //     until the MAX_COMPONENTS-th bit
 using Signature = std::bitset<MAX_COMPONENTS>;
 
+// a change tick stamps when a component was last added or marked as changed
+//      the ticks only go forward, see Coordinator::advanceTick
+using ChangeTick = std::uint32_t;
+
 
 
 #endif
\ No newline at end of file
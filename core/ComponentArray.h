@@ -1,9 +1,13 @@
 #ifndef CORE_COMPONENT_ARRAY_H
 #define CORE_COMPONENT_ARRAY_H
 
-#include <array>
-#include <unordered_map>
+#include <vector>
 #include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#include <atomic>
 
 
 #include "Component.h"
@@ -17,17 +21,29 @@ class InterfaceComponentArray
 public:
     virtual ~InterfaceComponentArray() = default;
     virtual void entityDestroyed(Entity) = 0;
+
+    // copy the component of the source entity, if it has one, to every destination entity
+    virtual void cloneData(Entity source, const Entity *destinations, size_t count) = 0;
 };
 
 // the turbo packed array of component T
+//      each slot also keeps the tick of its last change so consumers
+//      can only process what changed since they last looked
 template <class T>
 class ComponentArray : public InterfaceComponentArray
 {
 public:
+    // the array reads the current tick from tickSource when stamping changes
+    explicit ComponentArray(const std::atomic<ChangeTick> *tickSource = nullptr) : tickSource(tickSource) {}
+
     // insert a component for an entity in the component array
     //      and make sure to map them good
     void insertData(Entity, T);
 
+    // insert count components at once, components[i] going to entities[i]
+    //      trivially copyable components are copied with a single memcpy
+    void insertData(const Entity *entities, const T *components, size_t count);
+
     // remove an entity's stored data from the component
     //      and make sure the array stays dense/packed
     //      for this we will overwrite the component to be
@@ -37,72 +53,201 @@ public:
 
     // getter for the data of the component associated to the
     //      entity. It returns a reference to it so it can be
-    //      edited.
+    //      edited. The reference is valid until the next insertion
     T& getData(Entity);
 
+    // test if the entity has data in this array
+    bool hasData(Entity) const;
+
+    // stamp the entity's data with the current tick, call it after editing through getData
+    void markChanged(Entity);
+
+    // tick of the last change of the entity's data
+    ChangeTick getChangeTick(Entity) const;
+
+    // append to the list the entities whose data changed at or after the given tick
+    //      a linear scan over the packed ticks, no access to the data itself
+    void getChangedEntities(ChangeTick since, std::vector<Entity> &) const;
+
     // destroy the component of an entity
     void entityDestroyed(Entity) override;
 
+    void cloneData(Entity source, const Entity *destinations, size_t count) override;
+
 private:
-    // the packed array of type T having MAX_ENTITIES allowed entry
-    // each unique entity has its own slot
-    std::array<T, MAX_ENTITIES> componentArray;
+    // marks an entity without component in mapEntityToComponent
+    static constexpr std::uint32_t INVALID_INDEX = UINT32_MAX;
+
+    // the packed array of type T, one slot per entity having the component
+    std::vector<T> componentArray;
 
     // map the entity to the component array index
     // ie : the entity has the given component and its data are stored at this index
-    std::unordered_map<Entity, size_t> mapEntityToComponent;
+    //      indexed by entity index and grown on demand, INVALID_INDEX when absent
+    std::vector<std::uint32_t> mapEntityToComponent;
 
     // map the indices of the component array to entities
     // ie : the component at the given index is associated to entity
-    std::unordered_map<size_t, Entity> mapComponentToEntity;
+    //      full handles, so a stale handle on a reused slot has no data
+    std::vector<Entity> mapComponentToEntity;
 
+    // tick of the last change of each slot, packed like componentArray
+    std::vector<ChangeTick> changeTicks;
 
-    // count of valid associated components in component array aka size of
-    //      valid entries in componentArray
-    size_t validComponentNumber;
-};
+    // where the current tick is read, owned by the ComponentManager
+    const std::atomic<ChangeTick> *tickSource;
 
-#endif
+    ChangeTick currentTick() const { return tickSource ? tickSource->load(std::memory_order_relaxed) : 0; }
+
+    // make sure mapEntityToComponent can be indexed by the entity's index
+    void growIndexFor(Entity);
+
+    // the entity of the batch with the highest index
+    static Entity highestEntity(const Entity *, size_t count);
+};
 
 // Template implementations for ComponentArray moved into header
+template <class T>
+void ComponentArray<T>::growIndexFor(Entity entity)
+{
+    EntityIndex index = getEntityIndex(entity);
+    assert(index < MAX_ENTITIES && "Entity out of range for the component array");
+    if (index >= mapEntityToComponent.size())
+    {
+        mapEntityToComponent.resize(static_cast<size_t>(index) + 1, INVALID_INDEX);
+    }
+}
+
+template <class T>
+Entity ComponentArray<T>::highestEntity(const Entity *entities, size_t count)
+{
+    return *std::max_element(entities, entities + count, [](Entity a, Entity b) {
+        return getEntityIndex(a) < getEntityIndex(b);
+    });
+}
+
+template <class T>
+bool ComponentArray<T>::hasData(Entity entity) const
+{
+    EntityIndex index = getEntityIndex(entity);
+    return index < mapEntityToComponent.size() && mapEntityToComponent[index] != INVALID_INDEX
+        && mapComponentToEntity[mapEntityToComponent[index]] == entity;
+}
+
 template <class T>
 void ComponentArray<T>::insertData(Entity entity, T component)
 {
-    assert(mapComponentToEntity.find(entity) == mapComponentToEntity.end() && "Component added to the same entity more than once");
-    size_t indexComponent = validComponentNumber; // next after last valid
-    mapEntityToComponent[entity] = indexComponent;
-    mapComponentToEntity[indexComponent] = entity;
-    componentArray[indexComponent] = component;
-    validComponentNumber++;
+    assert(!hasData(entity) && "Component added to the same entity more than once");
+    growIndexFor(entity);
+    std::uint32_t indexComponent = static_cast<std::uint32_t>(componentArray.size()); // next after last valid
+    mapEntityToComponent[getEntityIndex(entity)] = indexComponent;
+    mapComponentToEntity.push_back(entity);
+    changeTicks.push_back(currentTick());
+    componentArray.push_back(std::move(component));
+}
+
+template <class T>
+void ComponentArray<T>::insertData(const Entity *entities, const T *components, size_t count)
+{
+    if (count == 0) return;
+    std::uint32_t firstIndex = static_cast<std::uint32_t>(componentArray.size());
+
+    // map every entity to its future slot
+    growIndexFor(highestEntity(entities, count));
+    mapComponentToEntity.insert(mapComponentToEntity.end(), entities, entities + count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        EntityIndex index = getEntityIndex(entities[i]);
+        assert(mapEntityToComponent[index] == INVALID_INDEX && "Component added to the same entity more than once");
+        mapEntityToComponent[index] = firstIndex + static_cast<std::uint32_t>(i);
+    }
+    changeTicks.resize(firstIndex + count, currentTick());
+
+    // copy the data in one go
+    if constexpr (std::is_trivially_copyable_v<T>)
+    {
+        componentArray.resize(firstIndex + count);
+        std::memcpy(componentArray.data() + firstIndex, components, count * sizeof(T));
+    }
+    else
+    {
+        componentArray.insert(componentArray.end(), components, components + count);
+    }
 }
 
 template <class T>
 void ComponentArray<T>::removeData(Entity entity)
 {
-    assert(mapEntityToComponent.find(entity) != mapEntityToComponent.end() && "Component doesnt exist and therefore can't be removed.");
-    size_t indexOfRemovedEntity = mapEntityToComponent[entity];
-    size_t indexOfLastElement = validComponentNumber - 1;
-    componentArray[indexOfRemovedEntity] = componentArray[indexOfLastElement];
+    assert(hasData(entity) && "Component doesnt exist and therefore can't be removed.");
+    std::uint32_t indexOfRemovedEntity = mapEntityToComponent[getEntityIndex(entity)];
+    std::uint32_t indexOfLastElement = static_cast<std::uint32_t>(componentArray.size() - 1);
+    componentArray[indexOfRemovedEntity] = std::move(componentArray[indexOfLastElement]);
     Entity entityOfLastElement = mapComponentToEntity[indexOfLastElement];
-    mapEntityToComponent[entityOfLastElement] = indexOfRemovedEntity;
+    mapEntityToComponent[getEntityIndex(entityOfLastElement)] = indexOfRemovedEntity;
     mapComponentToEntity[indexOfRemovedEntity] = entityOfLastElement;
-    mapEntityToComponent.erase(entity);
-    mapComponentToEntity.erase(indexOfLastElement);
-    validComponentNumber--;
+    changeTicks[indexOfRemovedEntity] = changeTicks[indexOfLastElement];
+    mapEntityToComponent[getEntityIndex(entity)] = INVALID_INDEX;
+    mapComponentToEntity.pop_back();
+    changeTicks.pop_back();
+    componentArray.pop_back();
 }
 
 template <class T>
 T &ComponentArray<T>::getData(Entity entity)
 {
-    assert(mapEntityToComponent.find(entity) != mapEntityToComponent.end() && "Component doesnt exist and therefore can't be accessed.");
-    return componentArray[mapEntityToComponent[entity]];
+    assert(hasData(entity) && "Component doesnt exist and therefore can't be accessed.");
+    return componentArray[mapEntityToComponent[getEntityIndex(entity)]];
+}
+
+template <class T>
+void ComponentArray<T>::markChanged(Entity entity)
+{
+    assert(hasData(entity) && "Component doesnt exist and therefore can't be marked as changed.");
+    changeTicks[mapEntityToComponent[getEntityIndex(entity)]] = currentTick();
+}
+
+template <class T>
+ChangeTick ComponentArray<T>::getChangeTick(Entity entity) const
+{
+    assert(hasData(entity) && "Component doesnt exist and therefore has no change tick.");
+    return changeTicks[mapEntityToComponent[getEntityIndex(entity)]];
+}
+
+template <class T>
+void ComponentArray<T>::getChangedEntities(ChangeTick since, std::vector<Entity> &changed) const
+{
+    for (size_t i = 0; i < changeTicks.size(); ++i)
+    {
+        if (changeTicks[i] >= since) changed.push_back(mapComponentToEntity[i]);
+    }
 }
 
 template <class T>
 void ComponentArray<T>::entityDestroyed(Entity entity)
 {
-    if (mapEntityToComponent.find(entity) != mapEntityToComponent.end())
+    if (hasData(entity))
     {
         removeData(entity);
     }
-}
\ No newline at end of file
+}
+
+template <class T>
+void ComponentArray<T>::cloneData(Entity source, const Entity *destinations, size_t count)
+{
+    if (!hasData(source) || count == 0) return;
+    // copy the prototype first : growing the array would invalidate a reference to it
+    T prototype = getData(source);
+    std::uint32_t firstIndex = static_cast<std::uint32_t>(componentArray.size());
+    growIndexFor(highestEntity(destinations, count));
+    mapComponentToEntity.insert(mapComponentToEntity.end(), destinations, destinations + count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        EntityIndex index = getEntityIndex(destinations[i]);
+        assert(mapEntityToComponent[index] == INVALID_INDEX && "Component added to the same entity more than once");
+        mapEntityToComponent[index] = firstIndex + static_cast<std::uint32_t>(i);
+    }
+    changeTicks.resize(firstIndex + count, currentTick());
+    componentArray.resize(firstIndex + count, prototype);
+}
+
+#endif
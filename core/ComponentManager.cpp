@@ -14,3 +14,18 @@ void ComponentManager::entityDestroyed(Entity entity)
     }
 }
 
+void ComponentManager::cloneComponents(Entity source, const Entity *destinations, size_t count)
+{
+    // each ComponentArray copies the data only if the source entity has that component
+    for (auto const &pair : mapTypeNameToComponentArray)
+    {
+        pair.second->cloneData(source, destinations, count);
+    }
+}
+
+void ComponentManager::removeComponent(Entity entity, ComponentType type)
+{
+    assert(componentArraysByType[type] && "Component not registered. Can't remove it");
+    // entityDestroyed only removes the data if the entity has some
+    componentArraysByType[type]->entityDestroyed(entity);
+}
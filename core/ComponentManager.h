@@ -2,6 +2,8 @@
 #define CORE_COMPONENT_MANAGER_H
 
 #include <unordered_map>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <typeinfo>
 #include <cassert>
@@ -31,17 +33,45 @@ public:
     template <typename T>
     void addComponent(Entity, T);
 
+    // associate components[i] to entities[i] for count entities at once
+    template <typename T>
+    void addComponents(const Entity *entities, const T *components, size_t count);
+
     // un-associate the given component to the given entity and vice-versa
     template <typename T>
     void removeComponent(Entity);
 
+    // same as above when the type is only known by its component id
+    void removeComponent(Entity, ComponentType);
+
     // get the reference to the component of an entity
     template <typename T>
     T &getComponent(Entity);
 
+    // stamp the entity's T with the current tick
+    template <typename T>
+    void markChanged(Entity);
+
+    // tick of the last change of the entity's T
+    template <typename T>
+    ChangeTick getChangeTick(Entity);
+
+    // append the entities whose T changed at or after the given tick
+    template <typename T>
+    void getChangedEntities(ChangeTick since, std::vector<Entity> &);
+
+    // the tick stamped on changes made from now on
+    ChangeTick getTick() const { return currentTick.load(std::memory_order_relaxed); }
+
+    // move to the next tick and return it, thread safe
+    ChangeTick advanceTick() { return currentTick.fetch_add(1, std::memory_order_relaxed) + 1; }
+
     // notify each ComponentArray that the given entity has been destroyed
     void entityDestroyed(Entity);
 
+    // copy every component of the source entity to each destination entity
+    void cloneComponents(Entity source, const Entity *destinations, size_t count);
+
 private:
     // map name of the type to the unique id of the component (componentType)
     std::unordered_map<const char *, ComponentType> mapTypeNameToComponentType;
@@ -49,23 +79,28 @@ private:
     // map the name of the type to the ComponentArray
     std::unordered_map<const char *, std::shared_ptr<InterfaceComponentArray>> mapTypeNameToComponentArray;
 
+    // the ComponentArrays indexed by their component id
+    std::array<std::shared_ptr<InterfaceComponentArray>, MAX_COMPONENTS> componentArraysByType;
+
     // the component id (ComponentType) to be attributed next
-    ComponentType nextComponentType;
+    ComponentType nextComponentType = 0;
+
+    // tick stamped on the component changes, shared with every ComponentArray
+    std::atomic<ChangeTick> currentTick{1};
 
     // get the string pointer of the ComponentArray of type T
     template <typename T>
     std::shared_ptr<ComponentArray<T>> getComponentArray();
 };
 
-#endif
-
 // Template implementations moved into header so they are available to all TUs.
 template <typename T>
 std::shared_ptr<ComponentArray<T>> ComponentManager::getComponentArray()
 {
     const char *typeName = typeid(T).name();
-    assert(mapTypeNameToComponentArray.find(typeName) != mapTypeNameToComponentArray.end() && "Component not registered. Can't get its ComponentArray");
-    return std::static_pointer_cast<ComponentArray<T>>(mapTypeNameToComponentArray[typeName]);
+    auto found = mapTypeNameToComponentArray.find(typeName);
+    assert(found != mapTypeNameToComponentArray.end() && "Component not registered. Can't get its ComponentArray");
+    return std::static_pointer_cast<ComponentArray<T>>(found->second);
 }
 
 template <typename T>
@@ -73,8 +108,11 @@ void ComponentManager::registerComponent()
 {
     const char *typeName = typeid(T).name();
     assert(mapTypeNameToComponentType.find(typeName) == mapTypeNameToComponentType.end() && "Registering an already existing component");
+    assert(nextComponentType < MAX_COMPONENTS && "Too many component types");
+    auto componentArray = std::make_shared<ComponentArray<T>>(&currentTick);
     mapTypeNameToComponentType.insert({typeName, nextComponentType});
-    mapTypeNameToComponentArray.insert({typeName, std::make_shared<ComponentArray<T>>()});
+    mapTypeNameToComponentArray.insert({typeName, componentArray});
+    componentArraysByType[nextComponentType] = componentArray;
     nextComponentType++;
 }
 
@@ -82,8 +120,10 @@ template <typename T>
 ComponentType ComponentManager::getComponentType()
 {
     const char *typeName = typeid(T).name();
-    assert(mapTypeNameToComponentType.find(typeName) != mapTypeNameToComponentType.end() && "Component not registered. Can't get its type");
-    return mapTypeNameToComponentType[typeName];
+    // lookup only, so command buffers can resolve types from several threads
+    auto found = mapTypeNameToComponentType.find(typeName);
+    assert(found != mapTypeNameToComponentType.end() && "Component not registered. Can't get its type");
+    return found->second;
 }
 
 template <typename T>
@@ -92,6 +132,12 @@ void ComponentManager::addComponent(Entity entity, T component)
     getComponentArray<T>()->insertData(entity, component);
 }
 
+template <typename T>
+void ComponentManager::addComponents(const Entity *entities, const T *components, size_t count)
+{
+    getComponentArray<T>()->insertData(entities, components, count);
+}
+
 template <typename T>
 void ComponentManager::removeComponent(Entity entity)
 {
@@ -102,4 +148,24 @@ template <typename T>
 T &ComponentManager::getComponent(Entity entity)
 {
     return getComponentArray<T>()->getData(entity);
-}
\ No newline at end of file
+}
+
+template <typename T>
+void ComponentManager::markChanged(Entity entity)
+{
+    getComponentArray<T>()->markChanged(entity);
+}
+
+template <typename T>
+ChangeTick ComponentManager::getChangeTick(Entity entity)
+{
+    return getComponentArray<T>()->getChangeTick(entity);
+}
+
+template <typename T>
+void ComponentManager::getChangedEntities(ChangeTick since, std::vector<Entity> &changed)
+{
+    getComponentArray<T>()->getChangedEntities(since, changed);
+}
+
+#endif
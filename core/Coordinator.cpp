@@ -1,4 +1,8 @@
 #include "Coordinator.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <unordered_map>
 
 void Coordinator::init()
 {
@@ -7,6 +11,9 @@ void Coordinator::init()
     componentManager = std::make_unique<ComponentManager>();
     systemManager = std::make_unique<SystemManager>();
 
+    // init again starts an empty world : the threads' command buffers now record for it
+    std::lock_guard<std::mutex> lock(commandBuffersMutex);
+    for (auto &buffer : commandBuffers) buffer->reset(componentManager.get());
 }
 
 // entity methods
@@ -23,3 +30,206 @@ void Coordinator::destroyEntity(Entity entity)
     systemManager->entityDestroyed(entity);
 }
 
+bool Coordinator::isAlive(Entity entity)
+{
+    return entityManager->isAlive(entity);
+}
+
+std::vector<Entity> Coordinator::createEntities(size_t count)
+{
+    std::vector<Entity> entities(count);
+    entityManager->createEntities(entities.data(), count);
+    return entities;
+}
+
+std::vector<Entity> Coordinator::createEntities(size_t count, Entity prototype)
+{
+    std::vector<Entity> entities = createEntities(count);
+    if (count == 0) return entities;
+
+    // copy the components, then give the whole batch the prototype's signature at once
+    componentManager->cloneComponents(prototype, entities.data(), count);
+    Signature signature = entityManager->getSignature(prototype);
+    for (Entity entity : entities)
+    {
+        entityManager->setSignature(entity, signature);
+    }
+    systemManager->entitiesSignatureChanged(entities.data(), count, signature);
+
+    return entities;
+}
+
+// change tracking
+
+ChangeTick Coordinator::getTick()
+{
+    return componentManager->getTick();
+}
+
+ChangeTick Coordinator::advanceTick()
+{
+    return componentManager->advanceTick();
+}
+
+// deferred structural changes
+
+CommandBuffer &Coordinator::getCommandBuffer()
+{
+    // each thread keeps the buffer it got from this coordinator so recording needs no lock
+    thread_local std::unordered_map<const Coordinator *, CommandBuffer *> buffersOfThread;
+    auto found = buffersOfThread.find(this);
+    if (found != buffersOfThread.end()) return *found->second;
+
+    std::lock_guard<std::mutex> lock(commandBuffersMutex);
+    commandBuffers.push_back(std::make_unique<CommandBuffer>(componentManager.get()));
+    CommandBuffer *buffer = commandBuffers.back().get();
+    buffersOfThread.insert({this, buffer});
+    return *buffer;
+}
+
+void Coordinator::flushCommands()
+{
+    PROFILE_ZONE("Coordinator::flushCommands");
+    std::lock_guard<std::mutex> lock(commandBuffersMutex);
+
+    // a recorded command with its placeholder resolved, and where it comes from
+    struct PendingCommand
+    {
+        Entity entity;
+        std::uint32_t buffer;
+        std::uint32_t sequence;
+        const CommandBuffer::Command *command;
+    };
+
+    // give real ids to the placeholders and gather every command
+    std::vector<PendingCommand> pending;
+    for (std::uint32_t b = 0; b < commandBuffers.size(); ++b)
+    {
+        CommandBuffer &buffer = *commandBuffers[b];
+        if (buffer.empty()) continue;
+        std::vector<Entity> created = createEntities(buffer.createdCount);
+        for (std::uint32_t i = 0; i < buffer.commands.size(); ++i)
+        {
+            const CommandBuffer::Command &command = buffer.commands[i];
+            Entity entity = command.entity;
+            if (entity & PENDING_ENTITY_BIT)
+            {
+                assert((entity & ~PENDING_ENTITY_BIT) < created.size() && "Placeholder entity from another command buffer");
+                entity = created[entity & ~PENDING_ENTITY_BIT];
+            }
+            pending.push_back({entity, b, i, &command});
+        }
+    }
+    if (pending.empty())
+    {
+        for (auto &buffer : commandBuffers) buffer->clear();
+        return;
+    }
+
+    // group the commands by entity, keeping the recording order inside each group
+    std::sort(pending.begin(), pending.end(), [](const PendingCommand &a, const PendingCommand &b) {
+        if (a.entity != b.entity) return a.entity < b.entity;
+        if (a.buffer != b.buffer) return a.buffer < b.buffer;
+        return a.sequence < b.sequence;
+    });
+
+    // component insertions are batched per buffer and per component type
+    struct InsertBatch
+    {
+        std::vector<Entity> entities;
+        std::vector<std::uint32_t> payloadIndices;
+    };
+    std::vector<std::array<InsertBatch, MAX_COMPONENTS>> inserts(commandBuffers.size());
+
+    std::vector<Entity> destroyed;
+    std::vector<Entity> changedEntities;
+    std::vector<Signature> changedSignatures;
+
+    for (size_t first = 0; first < pending.size();)
+    {
+        Entity entity = pending[first].entity;
+        size_t last = first;
+        while (last < pending.size() && pending[last].entity == entity) ++last;
+
+        // only the last add/remove of each component type matters, a destroy ends the group
+        bool isDestroyed = false;
+        Signature touched;
+        std::array<const PendingCommand *, MAX_COMPONENTS> lastCommandOfType;
+        for (size_t i = first; i < last && !isDestroyed; ++i)
+        {
+            const CommandBuffer::Command &command = *pending[i].command;
+            if (command.kind == CommandBuffer::CommandKind::Destroy)
+            {
+                isDestroyed = true;
+                continue;
+            }
+            touched.set(command.type);
+            lastCommandOfType[command.type] = &pending[i];
+        }
+        first = last;
+
+        // commands recorded on an entity destroyed since then are dropped
+        if (!entityManager->isAlive(entity)) continue;
+
+        if (isDestroyed)
+        {
+            destroyed.push_back(entity);
+            continue;
+        }
+
+        Signature before = entityManager->getSignature(entity);
+        Signature after = before;
+        for (ComponentType type = 0; type < MAX_COMPONENTS; ++type)
+        {
+            if (!touched[type]) continue;
+            const PendingCommand &winner = *lastCommandOfType[type];
+            if (winner.command->kind == CommandBuffer::CommandKind::Add)
+            {
+                auto &payload = *commandBuffers[winner.buffer]->payloads[type];
+                if (before[type])
+                {
+                    payload.assignTo(*componentManager, entity, winner.command->payloadIndex);
+                }
+                else
+                {
+                    inserts[winner.buffer][type].entities.push_back(entity);
+                    inserts[winner.buffer][type].payloadIndices.push_back(winner.command->payloadIndex);
+                }
+                after.set(type, true);
+            }
+            else if (before[type])
+            {
+                componentManager->removeComponent(entity, type);
+                after.set(type, false);
+            }
+        }
+
+        if (after != before)
+        {
+            entityManager->setSignature(entity, after);
+            changedEntities.push_back(entity);
+            changedSignatures.push_back(after);
+        }
+    }
+
+    // one bulk insert per component type and buffer
+    for (size_t b = 0; b < inserts.size(); ++b)
+    {
+        for (ComponentType type = 0; type < MAX_COMPONENTS; ++type)
+        {
+            InsertBatch &batch = inserts[b][type];
+            if (batch.entities.empty()) continue;
+            commandBuffers[b]->payloads[type]->insertInto(*componentManager, batch.entities.data(), batch.payloadIndices.data(), batch.entities.size());
+        }
+    }
+
+    // then the systems see every changed entity once
+    systemManager->entitiesSignatureChanged(changedEntities.data(), changedSignatures.data(), changedEntities.size());
+
+    for (Entity entity : destroyed)
+    {
+        destroyEntity(entity);
+    }
+
+    for (auto &buffer : commandBuffers) buffer->clear();
+}
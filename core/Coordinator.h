@@ -2,11 +2,15 @@
 #define CORE_COORDINATOR_H
 
 #include <memory>
+#include <vector>
+#include <mutex>
+#include <cassert>
 
 
 #include "EntityManager.h"
 #include "ComponentManager.h"
 #include "SystemManager.h"
+#include "CommandBuffer.h"
 
 // Avoid including concrete component/system headers here to prevent circular
 // includes. Templates are defined below and will be instantiated where needed.
@@ -21,6 +25,11 @@ public:
     // Entity methods
     Entity createEntity();
     void destroyEntity(Entity);
+    bool isAlive(Entity);                                        // false for destroyed entities and stale handles
+
+    // bulk entity methods
+    std::vector<Entity> createEntities(size_t count);                   // count entities without components
+    std::vector<Entity> createEntities(size_t count, Entity prototype); // count copies of the prototype's components
 
     // Component methods
     template<typename T> void registerComponent();               // register component
@@ -30,9 +39,25 @@ public:
     template<typename T> ComponentType getComponentType();       // get type T's component type
     template<typename T> bool hasComponent(Entity);              // test if an entity has the T component
 
+    // change tracking : a component is stamped with the current tick when added or marked
+    template<typename T> void markChanged(Entity);               // flag the entity's T as changed, after editing it
+    template<typename T> bool hasChangedSince(Entity, ChangeTick); // true if T was changed at or after the tick
+    template<typename T> void getChangedEntities(ChangeTick since, std::vector<Entity>&); // entities whose T changed at or after the tick
+    ChangeTick getTick();                                        // the tick stamped on changes made now
+    ChangeTick advanceTick();                                    // start a new tick and return it
+
+    // associate components[i] of each type to entities[i], the signature and
+    //      the systems membership are updated once per entity for the whole batch
+    template<typename... Ts> void addComponents(const std::vector<Entity>&, const std::vector<Ts>&...);
+
+    // Deferred structural changes
+    CommandBuffer& getCommandBuffer();                           // the calling thread's command buffer
+    void flushCommands();                                        // apply every recorded command, call outside system loops
+
     // System methods
     template<typename T> std::shared_ptr<T> registerSystem();    // register system
     template<typename T> void setSystemSignature(Signature);     // setter for the system signature 
+    template<typename T> void setSystemAccess(Signature reads, Signature writes); // components read and written by the system
 
 
 private:
@@ -41,6 +66,10 @@ private:
     std::unique_ptr<ComponentManager> componentManager;
     std::unique_ptr<SystemManager> systemManager;
 
+    // one command buffer per thread that recorded something, handed out under the mutex
+    std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+    std::mutex commandBuffersMutex;
+
 };
 
 // Template implementations for Coordinator (inside include guard)
@@ -62,6 +91,28 @@ void Coordinator::addComponent(Entity entity, T component)
     systemManager->entitySignatureChanged(entity, signature);
 }
 
+template<typename... Ts>
+void Coordinator::addComponents(const std::vector<Entity> &entities, const std::vector<Ts> &...components)
+{
+    const size_t count = entities.size();
+    assert(((components.size() == count) && ...) && "Each component batch needs one entry per entity");
+
+    // one bulk copy per component type
+    (componentManager->addComponents(entities.data(), components.data(), count), ...);
+
+    Signature added;
+    (added.set(componentManager->getComponentType<Ts>(), true), ...);
+
+    std::vector<Signature> signatures(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        signatures[i] = entityManager->getSignature(entities[i]) | added;
+        entityManager->setSignature(entities[i], signatures[i]);
+    }
+
+    systemManager->entitiesSignatureChanged(entities.data(), signatures.data(), count);
+}
+
 template<typename T>
 void Coordinator::removeComponent(Entity entity)
 {
@@ -80,6 +131,24 @@ T& Coordinator::getComponent(Entity entity)
     return componentManager->getComponent<T>(entity);
 }
 
+template<typename T>
+void Coordinator::markChanged(Entity entity)
+{
+    componentManager->markChanged<T>(entity);
+}
+
+template<typename T>
+bool Coordinator::hasChangedSince(Entity entity, ChangeTick since)
+{
+    return componentManager->getChangeTick<T>(entity) >= since;
+}
+
+template<typename T>
+void Coordinator::getChangedEntities(ChangeTick since, std::vector<Entity> &changed)
+{
+    componentManager->getChangedEntities<T>(since, changed);
+}
+
 template<typename T>
 ComponentType Coordinator::getComponentType()
 {
@@ -106,4 +175,10 @@ void Coordinator::setSystemSignature(Signature signature)
     systemManager->setSignature<T>(signature);
 }
 
+template <typename T>
+void Coordinator::setSystemAccess(Signature reads, Signature writes)
+{
+    systemManager->setAccess<T>(reads, writes);
+}
+
 #endif
\ No newline at end of file
@@ -3,12 +3,41 @@
 
 #include <cstdint>
 
-// an Entity alias treated as an unsigned 32bit integer
-using Entity = std::uint32_t; 
+// an Entity is a versioned handle on an unsigned 64bit integer
+//      - the low 32 bits are the index of the entity slot, used to index the arrays
+//      - the high 32 bits are the generation of the slot when the entity was created
+// a slot is reused once its entity is destroyed but with the next generation,
+//      so a stale handle kept somewhere never aliases the new entity
+using Entity = std::uint64_t;
+using EntityIndex = std::uint32_t;
+using EntityGeneration = std::uint32_t;
 
 // max entity, used for arrays
-const Entity MAX_ENTITIES = 5000;
+//      large enough for a million photons, override with -DECS_MAX_ENTITIES=...
+#ifndef ECS_MAX_ENTITIES
+#define ECS_MAX_ENTITIES (1u << 20)
+#endif
+const EntityIndex MAX_ENTITIES = ECS_MAX_ENTITIES;
 
+// generations wrap before reaching the top bit, kept free for command buffer placeholders
+const EntityGeneration MAX_GENERATION = (EntityGeneration(1) << 31) - 1;
 
+// a handle that never designates a living entity
+const Entity NULL_ENTITY = ~Entity(0);
 
-#endif
\ No newline at end of file
+inline EntityIndex getEntityIndex(Entity entity)
+{
+    return static_cast<EntityIndex>(entity);
+}
+
+inline EntityGeneration getEntityGeneration(Entity entity)
+{
+    return static_cast<EntityGeneration>(entity >> 32);
+}
+
+inline Entity makeEntity(EntityIndex index, EntityGeneration generation)
+{
+    return (static_cast<Entity>(generation) << 32) | index;
+}
+
+#endif
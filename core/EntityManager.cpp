@@ -2,64 +2,102 @@
 
 EntityManager::EntityManager()
 {
-    // initialise the queue with all the possible ids
-    unusedIDs = std::queue<Entity>();
-
-    // iterate over the unused ids to give them the next possible id
-    //      here it just push all valid ids into the unused ids for initialization.
-    for(Entity entity = 0; entity < MAX_ENTITIES; ++entity) {
-        unusedIDs.push(entity);
-    }
+    livingEntityCount = 0;
 }
 
 
 Entity EntityManager::createEntity()
 {
-    // this insure there is at least one unused id
+    // this insure there is at least one unused slot
     assert(livingEntityCount < MAX_ENTITIES && "Too many entities !!");
 
-
-    // allocate the next unused ids
-    Entity id = unusedIDs.front();
-    // remove it from the queue
-    unusedIDs.pop();
     // increment the living count
     livingEntityCount++;
 
-    return id;
+    // reuse a freed slot if there is one, its generation was bumped on destruction
+    if (!freeIndices.empty())
+    {
+        EntityIndex index = freeIndices.back();
+        freeIndices.pop_back();
+        return makeEntity(index, generations[index]);
+    }
+
+    // otherwise open a new slot
+    EntityIndex index = static_cast<EntityIndex>(generations.size());
+    generations.push_back(0);
+    signaturesForEntity.emplace_back();
+    return makeEntity(index, 0);
+}
+
+void EntityManager::createEntities(Entity *entities, std::size_t count)
+{
+    // this insure there are enough unused slots for the whole batch
+    assert(livingEntityCount + count <= MAX_ENTITIES && "Too many entities !!");
+
+    // freed slots first
+    std::size_t reused = std::min(count, freeIndices.size());
+    for (std::size_t i = 0; i < reused; ++i)
+    {
+        EntityIndex index = freeIndices.back();
+        freeIndices.pop_back();
+        entities[i] = makeEntity(index, generations[index]);
+    }
+
+    // then the new slots, opened in one go
+    EntityIndex firstNew = static_cast<EntityIndex>(generations.size());
+    std::size_t opened = count - reused;
+    generations.resize(generations.size() + opened, 0);
+    signaturesForEntity.resize(signaturesForEntity.size() + opened);
+    for (std::size_t i = 0; i < opened; ++i)
+    {
+        entities[reused + i] = makeEntity(firstNew + static_cast<EntityIndex>(i), 0);
+    }
+
+    livingEntityCount += count;
 }
 
 void EntityManager::destroyEntity(Entity entity)
 {
-    // this insure we dont try to access an entity outside the entity table
-    assert(entity < MAX_ENTITIES && "Given entity for destruction is out of range");
+    // this insure we dont destroy a dead entity or a stale handle
+    assert(isAlive(entity) && "Given entity for destruction is not alive");
+
+    EntityIndex index = getEntityIndex(entity);
 
     // invalidate the signature
-    signaturesForEntity[entity].reset();
+    signaturesForEntity[index].reset();
+
+    // every handle on this slot is now stale
+    generations[index] = (generations[index] + 1) & MAX_GENERATION;
 
-    // put the destroyed id at the back of the queue
-    unusedIDs.push(entity);
+    // put the destroyed slot on the free list
+    freeIndices.push_back(index);
     // decrement the living count
     livingEntityCount--;
 
 }
 
+bool EntityManager::isAlive(Entity entity) const
+{
+    EntityIndex index = getEntityIndex(entity);
+    return index < generations.size() && generations[index] == getEntityGeneration(entity);
+}
+
 
 void EntityManager::setSignature( Entity entity, Signature signature)
 {
-    // make sure entity is in range
-    assert(entity < MAX_ENTITIES && "Given entity for signature attribution is out of range");
+    // make sure the handle is valid
+    assert(isAlive(entity) && "Given entity for signature attribution is not alive");
 
     // set the signature to the array at the entity's index
-    signaturesForEntity[entity] = signature;
+    signaturesForEntity[getEntityIndex(entity)] = signature;
 
 }
 
 Signature EntityManager::getSignature(Entity entity)
 {
-    // make sure entity is in range
-    assert(entity < MAX_ENTITIES && "Given entity for signature attribution is out of range");
+    // make sure the handle is valid
+    assert(isAlive(entity) && "Given entity for signature access is not alive");
 
     // get the signature from the array at the entity's index
-    return signaturesForEntity[entity];
-}
\ No newline at end of file
+    return signaturesForEntity[getEntityIndex(entity)];
+}
@@ -1,27 +1,34 @@
 #ifndef CORE_ENTITY_MANAGER_H
 #define CORE_ENTITY_MANAGER_H
 
-#include <queue>
-#include <array>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
 #include <cassert>
 
 
 #include "Entity.h"
 #include "Component.h" 
 
-// distribute the entity ids, keep record of the used ids
+// distribute the entity handles, keep record of the used slots and of their generation
 class EntityManager {
     public:
 
-    // initialise the queue with all the possible ids
+    // no slot is allocated up front, they are created on demand
     EntityManager();
 
-    // allocate if possible an id to a new entity, taking an id from the queue
+    // allocate if possible a handle to a new entity, reusing the last freed slot first
     Entity createEntity();
 
-    // destroy an entity, giving back its id to the queue
+    // allocate count handles at once and write them to the given array
+    void createEntities(Entity *, std::size_t count);
+
+    // destroy an entity, its slot goes to the free list with the next generation
     void destroyEntity(Entity);
 
+    // test if the handle designates a living entity, O(1)
+    bool isAlive(Entity) const;
+
     // setter for the signature of an entity
     void setSignature(Entity, Signature);
 
@@ -30,12 +37,15 @@ class EntityManager {
 
 
     private:
-    // id allocation queue
-    std::queue<Entity> unusedIDs;
+    // free list of slots whose entity was destroyed, reused last in first out
+    std::vector<EntityIndex> freeIndices;
+
+    // current generation of each slot created so far, indexed by entity index
+    //      a handle is alive when its generation matches the slot's
+    std::vector<EntityGeneration> generations;
 
-    // array of signature where array[entity] access the signature of entity
-    //      size is MAX_ENTITIES
-    std::array<Signature, MAX_ENTITIES> signaturesForEntity;
+    // array of signature where array[index] access the signature of the entity in that slot
+    std::vector<Signature> signaturesForEntity;
 
 
     // total living entities
@@ -45,4 +55,4 @@ class EntityManager {
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,124 @@
+#ifndef CORE_ENTITY_SET_H
+#define CORE_ENTITY_SET_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "Entity.h"
+
+// sparse set of entities used for the systems membership lists
+//      - the members are stored packed in a vector so iterating is a linear scan
+//      - a sparse index maps an entity index to its slot in the packed vector
+//        so insert, erase and contains are O(1) with no allocation per entity.
+//        The packed vector keeps the full handle, so a stale handle whose slot
+//        was reused is not a member
+//      - erase moves the last member into the hole (swap-remove), so the
+//        iteration order is the insertion order with holes refilled from the back.
+//        It does not depend on the entity values nor on the allocator : two runs
+//        doing the same operations iterate in the same order
+class EntitySet
+{
+public:
+    using const_iterator = std::vector<Entity>::const_iterator;
+
+    // add an entity to the set, return false if it was already a member
+    bool insert(Entity);
+
+    // add count entities, growing the sparse index once for the whole batch
+    void insert(const Entity *, std::size_t count);
+
+    // remove an entity from the set, return false if it was not a member
+    bool erase(Entity);
+
+    // test if the entity is a member
+    bool contains(Entity) const;
+
+    // reserve room for the given number of members
+    void reserve(std::size_t);
+
+    // remove every member
+    void clear();
+
+    std::size_t size() const { return packed.size(); }
+    bool empty() const { return packed.empty(); }
+
+    // the packed members, valid until the next insert/erase
+    const Entity *data() const { return packed.data(); }
+    Entity operator[](std::size_t i) const { return packed[i]; }
+
+    const_iterator begin() const { return packed.begin(); }
+    const_iterator end() const { return packed.end(); }
+
+private:
+    // marks an entity id without slot in the packed vector
+    static constexpr std::uint32_t INVALID_SLOT = UINT32_MAX;
+
+    // the members, densely packed
+    std::vector<Entity> packed;
+
+    // sparse[index] is the slot in packed of the entity with that index, or INVALID_SLOT
+    //      grown on demand up to the highest inserted entity index
+    std::vector<std::uint32_t> sparse;
+};
+
+inline bool EntitySet::contains(Entity entity) const
+{
+    EntityIndex index = getEntityIndex(entity);
+    return index < sparse.size() && sparse[index] != INVALID_SLOT && packed[sparse[index]] == entity;
+}
+
+inline bool EntitySet::insert(Entity entity)
+{
+    EntityIndex index = getEntityIndex(entity);
+    if (index >= sparse.size())
+    {
+        sparse.resize(static_cast<std::size_t>(index) + 1, INVALID_SLOT);
+    }
+    else if (sparse[index] != INVALID_SLOT)
+    {
+        // a stale handle on the same slot can't be inserted over the living one
+        return false;
+    }
+    sparse[index] = static_cast<std::uint32_t>(packed.size());
+    packed.push_back(entity);
+    return true;
+}
+
+inline void EntitySet::insert(const Entity *entities, std::size_t count)
+{
+    if (count == 0) return;
+    EntityIndex highest = 0;
+    for (std::size_t i = 0; i < count; ++i) highest = std::max(highest, getEntityIndex(entities[i]));
+    if (highest >= sparse.size()) sparse.resize(static_cast<std::size_t>(highest) + 1, INVALID_SLOT);
+    packed.reserve(packed.size() + count);
+    for (std::size_t i = 0; i < count; ++i) insert(entities[i]);
+}
+
+inline bool EntitySet::erase(Entity entity)
+{
+    if (!contains(entity)) return false;
+
+    // overwrite the removed slot with the last member and shrink by one
+    std::uint32_t slot = sparse[getEntityIndex(entity)];
+    Entity last = packed.back();
+    packed[slot] = last;
+    sparse[getEntityIndex(last)] = slot;
+    packed.pop_back();
+    sparse[getEntityIndex(entity)] = INVALID_SLOT;
+    return true;
+}
+
+inline void EntitySet::reserve(std::size_t capacity)
+{
+    packed.reserve(capacity);
+}
+
+inline void EntitySet::clear()
+{
+    for (Entity entity : packed) sparse[getEntityIndex(entity)] = INVALID_SLOT;
+    packed.clear();
+}
+
+#endif
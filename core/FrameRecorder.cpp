@@ -0,0 +1,124 @@
+#include "FrameRecorder.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+FrameRecorder::FrameRecorder(int width, int height, std::string output, int ringSize)
+    : width(width), height(height), output(std::move(output)), ring(ringSize)
+{
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLsizeiptr frameSize = static_cast<GLsizeiptr>(width) * height * 4;
+    for (PendingFrame &slot : ring)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    writer = std::make_unique<ThreadPool>(1);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    finish();
+    for (PendingFrame &slot : ring) glDeleteBuffers(1, &slot.pbo);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+void FrameRecorder::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+void FrameRecorder::capture()
+{
+    PROFILE_ZONE("FrameRecorder::capture");
+    // the slot's previous frame was captured ringSize frames ago, normally ready
+    PendingFrame &slot = ring[nextSlot];
+    if (slot.fence) collect(slot);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // with a pack buffer bound this only queues the copy, nothing waits
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frameNumber = capturedFrames++;
+
+    nextSlot = (nextSlot + 1) % static_cast<int>(ring.size());
+}
+
+void FrameRecorder::collect(PendingFrame &slot)
+{
+    PROFILE_ZONE("FrameRecorder::collect");
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+    {
+        status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // copy out of the mapping so the buffer is free for the next capture right away
+    size_t frameSize = static_cast<size_t>(width) * height * 4;
+    auto pixels = std::make_shared<std::vector<std::uint8_t>>(frameSize);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void *mapping = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+    if (mapping)
+    {
+        std::memcpy(pixels->data(), mapping, frameSize);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapping) return;
+
+    int frameNumber = slot.frameNumber;
+    int w = width, h = height;
+    std::string target = output;
+    writer->submit([pixels, frameNumber, w, h, target] {
+        bool written;
+        if (target == "-")
+        {
+            written = writePPM(stdout, pixels->data(), w, h, true) && std::fflush(stdout) == 0;
+        }
+        else
+        {
+            char path[1024];
+            std::snprintf(path, sizeof(path), target.c_str(), frameNumber);
+            written = writePPM(std::string(path), pixels->data(), w, h, true);
+        }
+        if (!written) std::cerr << "Failed to write frame " << frameNumber << std::endl;
+    });
+}
+
+void FrameRecorder::finish()
+{
+    // oldest first so the frames keep their order
+    for (size_t i = 0; i < ring.size(); ++i)
+    {
+        PendingFrame &slot = ring[(nextSlot + i) % ring.size()];
+        if (slot.fence) collect(slot);
+    }
+    // the pool joins its worker once the queue is empty
+    writer = std::make_unique<ThreadPool>(1);
+}
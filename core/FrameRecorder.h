@@ -0,0 +1,71 @@
+#ifndef CORE_FRAME_RECORDER_H
+#define CORE_FRAME_RECORDER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// renders into an offscreen framebuffer and saves every frame without stalling the GPU.
+//      capture() copies the frame into the next pixel buffer object of a ring with an
+//      asynchronous glReadPixels, and the frame of ringSize captures ago, long done
+//      by then, is mapped and handed to a writer thread. The frames are written
+//      in order as PPM images, either to numbered files or one after the other
+//      to stdout for an encoder, e.g. ffmpeg -f image2pipe -c:v ppm -i -
+//      Only needs GL 3.3, so it runs on Mesa's llvmpipe as well
+class FrameRecorder
+{
+public:
+    // output is a printf pattern for the file names, like "frame_%05d.ppm",
+    //      or "-" for stdout. Needs a current context
+    FrameRecorder(int width, int height, std::string output, int ringSize = 3);
+
+    // writes the frames still in flight
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+    // draw into the offscreen framebuffer from now on
+    void bind();
+
+    // queue the readback of the frame drawn since bind()
+    void capture();
+
+    // wait for every captured frame to be written
+    void finish();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getCapturedFrames() const { return capturedFrames; }
+
+private:
+    struct PendingFrame
+    {
+        GLuint pbo = 0;
+        GLsync fence = nullptr; // set while a readback is in flight
+        int frameNumber = 0;
+    };
+
+    int width;
+    int height;
+    std::string output;
+
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+
+    std::vector<PendingFrame> ring;
+    int nextSlot = 0;
+    int capturedFrames = 0;
+
+    // the writes leave the GL thread, one worker keeps them in order
+    std::unique_ptr<ThreadPool> writer;
+
+    // map the finished readback of a slot and queue its write
+    void collect(PendingFrame &);
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "ImageWriter.h"
+
+#include <vector>
+#include <array>
+#include <algorithm>
+
+bool writePPM(std::FILE *file, const std::uint8_t *rgba, int width, int height, bool bottomUp)
+{
+    if (std::fprintf(file, "P6\n%d %d\n255\n", width, height) < 0) return false;
+    std::vector<std::uint8_t> row(static_cast<size_t>(width) * 3);
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint8_t *source = rgba + static_cast<size_t>(bottomUp ? height - 1 - y : y) * width * 4;
+        for (int x = 0; x < width; ++x)
+        {
+            row[x * 3] = source[x * 4];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + 2];
+        }
+        if (std::fwrite(row.data(), 1, row.size(), file) != row.size()) return false;
+    }
+    return true;
+}
+
+bool writePPM(const std::string &path, const std::uint8_t *rgba, int width, int height, bool bottomUp)
+{
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool written = writePPM(file, rgba, width, height, bottomUp);
+    return std::fclose(file) == 0 && written;
+}
+
+// CRC-32 of the PNG chunks (polynomial 0xEDB88320)
+static std::uint32_t crc32(const std::uint8_t *data, size_t size, std::uint32_t crc = 0)
+{
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t n = 0; n < 256; ++n)
+        {
+            std::uint32_t value = n;
+            for (int k = 0; k < 8; ++k) value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            t[n] = value;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void putBigEndian(std::vector<std::uint8_t> &out, std::uint32_t value)
+{
+    out.push_back(static_cast<std::uint8_t>(value >> 24));
+    out.push_back(static_cast<std::uint8_t>(value >> 16));
+    out.push_back(static_cast<std::uint8_t>(value >> 8));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+// append a chunk : length, type, data, CRC of type and data
+static void putChunk(std::vector<std::uint8_t> &out, const char *type, const std::vector<std::uint8_t> &data)
+{
+    putBigEndian(out, static_cast<std::uint32_t>(data.size()));
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian(out, crc32(&out[typeStart], out.size() - typeStart));
+}
+
+bool writePNG(const std::string &path, const std::uint8_t *rgba, int width, int height, bool bottomUp)
+{
+    // the scanlines, each one after its filter type byte (0, none)
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<std::uint8_t> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint8_t *row = rgba + static_cast<size_t>(bottomUp ? height - 1 - y : y) * rowSize;
+        raw.push_back(0);
+        raw.insert(raw.end(), row, row + rowSize);
+    }
+
+    // zlib stream of stored deflate blocks, 65535 bytes at most each
+    std::vector<std::uint8_t> zlib = {0x78, 0x01};
+    std::uint32_t a = 1, b = 0; // Adler-32
+    size_t offset = 0;
+    do
+    {
+        size_t size = std::min<size_t>(65535, raw.size() - offset);
+        bool final = offset + size == raw.size();
+        zlib.push_back(final ? 1 : 0);
+        zlib.push_back(static_cast<std::uint8_t>(size));
+        zlib.push_back(static_cast<std::uint8_t>(size >> 8));
+        zlib.push_back(static_cast<std::uint8_t>(~size));
+        zlib.push_back(static_cast<std::uint8_t>(~size >> 8));
+        for (size_t i = offset; i < offset + size; ++i)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+    putBigEndian(zlib, (b << 16) | a);
+
+    std::vector<std::uint8_t> header;
+    putBigEndian(header, static_cast<std::uint32_t>(width));
+    putBigEndian(header, static_cast<std::uint32_t>(height));
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA, no interlace
+
+    std::vector<std::uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    putChunk(png, "IHDR", header);
+    putChunk(png, "IDAT", zlib);
+    putChunk(png, "IEND", {});
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool written = std::fwrite(png.data(), 1, png.size(), file) == png.size();
+    return std::fclose(file) == 0 && written;
+}
+
+bool writeImage(const std::string &path, const std::uint8_t *rgba, int width, int height, bool bottomUp)
+{
+    bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+    return png ? writePNG(path, rgba, width, height, bottomUp) : writePPM(path, rgba, width, height, bottomUp);
+}
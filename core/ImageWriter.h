@@ -0,0 +1,23 @@
+#ifndef CORE_IMAGE_WRITER_H
+#define CORE_IMAGE_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// write a width x height RGBA8 image as a binary PPM (P6), alpha is dropped.
+//      rows are stored top to bottom unless bottomUp is set, as for glReadPixels output.
+//      Several images can be written to the same stream (image2pipe encoders read that)
+bool writePPM(std::FILE *, const std::uint8_t *rgba, int width, int height, bool bottomUp = false);
+
+// same into a file, false if it can't be written
+bool writePPM(const std::string &path, const std::uint8_t *rgba, int width, int height, bool bottomUp = false);
+
+// write a width x height RGBA8 image as a PNG. The pixels are stored uncompressed
+//      (deflate stored blocks), so no zlib is needed, at about the size of a PPM
+bool writePNG(const std::string &path, const std::uint8_t *rgba, int width, int height, bool bottomUp = false);
+
+// writePNG if the path ends in .png, writePPM otherwise
+bool writeImage(const std::string &path, const std::uint8_t *rgba, int width, int height, bool bottomUp = false);
+
+#endif
@@ -0,0 +1,162 @@
+#include "Profiler.h"
+
+#ifdef ASTRO_PROFILE
+
+#include <algorithm>
+#include <chrono>
+
+ProfileZoneInfo::ProfileZoneInfo(const char *name) : name(name)
+{
+    Profiler::get().registerZone(this);
+}
+
+ProfileCounterInfo::ProfileCounterInfo(const char *name) : name(name)
+{
+    Profiler::get().registerCounter(this);
+}
+
+Profiler::Profiler()
+{
+    frameStart = now();
+}
+
+Profiler &Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+std::uint64_t Profiler::now()
+{
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+Profiler::ThreadEvents &Profiler::threadEvents()
+{
+    thread_local ThreadEvents *events = nullptr;
+    if (!events)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threads.push_back(std::make_unique<ThreadEvents>());
+        events = threads.back().get();
+        events->threadId = static_cast<std::uint32_t>(threads.size());
+        events->ring.resize(RING_SIZE);
+    }
+    return *events;
+}
+
+void Profiler::record(const ProfileZoneInfo &zone, std::uint64_t start, std::uint64_t end)
+{
+    ThreadEvents &events = threadEvents();
+    events.ring[events.written % RING_SIZE] = {zone.name, start, end - start};
+    events.written++;
+}
+
+void Profiler::registerZone(ProfileZoneInfo *zone)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    zones.push_back(zone);
+}
+
+void Profiler::registerCounter(ProfileCounterInfo *counter)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    counters.push_back(counter);
+}
+
+bool Profiler::openCsv(const std::string &path)
+{
+    csv.open(path, std::ios::trunc);
+    if (!csv) return false;
+    csv << "frame,kind,name,value\n";
+    return true;
+}
+
+void Profiler::endFrame()
+{
+    std::uint64_t end = now();
+    std::vector<ProfileZoneInfo *> frameZones;
+    std::vector<ProfileCounterInfo *> frameCounters;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        frameZones = zones;
+        frameCounters = counters;
+    }
+
+    if (csv) csv << frame << ",frame,frame," << (end - frameStart) / 1e6 << "\n";
+    for (ProfileZoneInfo *zone : frameZones)
+    {
+        std::uint64_t ns = zone->frameNs.exchange(0, std::memory_order_relaxed);
+        std::uint64_t calls = zone->frameCalls.exchange(0, std::memory_order_relaxed);
+        if (csv && calls > 0)
+        {
+            csv << frame << ",ms," << zone->name << "," << ns / 1e6 << "\n";
+            csv << frame << ",calls," << zone->name << "," << calls << "\n";
+        }
+    }
+    for (ProfileCounterInfo *counter : frameCounters)
+    {
+        std::uint64_t value = counter->frameValue.exchange(0, std::memory_order_relaxed);
+        if (csv) csv << frame << ",counter," << counter->name << "," << value << "\n";
+
+        // kept for the trace, in a ring as well
+        CounterSample sample{counter->name, end, value};
+        if (counterSamples.size() < RING_SIZE) counterSamples.push_back(sample);
+        else counterSamples[countersWritten % RING_SIZE] = sample;
+        countersWritten++;
+    }
+    // flushed every second or so, the file stays usable if the run is killed
+    if (csv && frame % 64 == 0) csv.flush();
+
+    frame++;
+    frameStart = end;
+}
+
+// names are string literals from the code, only quotes and backslashes need escaping
+static void writeJsonString(std::ofstream &out, const char *text)
+{
+    out << '"';
+    for (const char *ch = text; *ch; ++ch)
+    {
+        if (*ch == '"' || *ch == '\\') out << '\\';
+        out << *ch;
+    }
+    out << '"';
+}
+
+bool Profiler::writeChromeTrace(const std::string &path)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+
+    // chrome://tracing wants microseconds
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto &events : threads)
+    {
+        std::uint64_t count = std::min<std::uint64_t>(events->written, RING_SIZE);
+        for (std::uint64_t i = events->written - count; i < events->written; ++i)
+        {
+            const Event &event = events->ring[i % RING_SIZE];
+            out << (first ? "\n" : ",\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << events->threadId << ",\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << event.duration / 1e3 << "}";
+            first = false;
+        }
+    }
+    std::uint64_t count = std::min<std::uint64_t>(countersWritten, RING_SIZE);
+    for (std::uint64_t i = countersWritten - count; i < countersWritten; ++i)
+    {
+        const CounterSample &sample = counterSamples[i % RING_SIZE];
+        out << (first ? "\n" : ",\n") << "{\"ph\":\"C\",\"pid\":1,\"name\":";
+        writeJsonString(out, sample.name);
+        out << ",\"ts\":" << sample.time / 1e3 << ",\"args\":{\"value\":" << sample.value << "}}";
+        first = false;
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+#endif
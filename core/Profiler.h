@@ -0,0 +1,157 @@
+#ifndef CORE_PROFILER_H
+#define CORE_PROFILER_H
+
+// frame profiler, compiled in with -DASTRO_PROFILE. Without it every macro below
+//      expands to nothing, so the instrumented code is exactly the plain code.
+//
+//      PROFILE_ZONE("name")         time the rest of the enclosing scope
+//      PROFILE_COUNT("name", value) add value to a per frame counter (draw calls, bytes...)
+//      PROFILE_FRAME()              close the frame : one CSV row per zone and counter
+//
+//      Each thread records its zones into its own ring buffer, without locks, and
+//      Profiler::writeChromeTrace() exports the rings as a chrome://tracing (or Perfetto)
+//      JSON file once the threads are done.
+//      The per frame totals go to a rolling CSV opened with Profiler::openCsv()
+#ifdef ASTRO_PROFILE
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// totals of one zone over the current frame, shared by every thread running it
+struct ProfileZoneInfo
+{
+    explicit ProfileZoneInfo(const char *name);
+
+    const char *name;
+    std::atomic<std::uint64_t> frameNs{0};
+    std::atomic<std::uint64_t> frameCalls{0};
+};
+
+// value of one counter over the current frame
+struct ProfileCounterInfo
+{
+    explicit ProfileCounterInfo(const char *name);
+
+    void add(std::uint64_t value) { frameValue.fetch_add(value, std::memory_order_relaxed); }
+
+    const char *name;
+    std::atomic<std::uint64_t> frameValue{0};
+};
+
+class Profiler
+{
+public:
+    static Profiler &get();
+
+    // nanoseconds since the profiler started
+    static std::uint64_t now();
+
+    // append a finished zone to the calling thread's ring
+    void record(const ProfileZoneInfo &, std::uint64_t start, std::uint64_t end);
+
+    // zones and counters register themselves at their first use
+    void registerZone(ProfileZoneInfo *);
+    void registerCounter(ProfileCounterInfo *);
+
+    // write the per frame totals to this file from now on, false if it can't be opened
+    bool openCsv(const std::string &path);
+
+    // close the frame : write the totals and start the next frame from zero
+    void endFrame();
+
+    // export the recorded zones and counters, call it when no other thread records anymore
+    bool writeChromeTrace(const std::string &path);
+
+private:
+    Profiler();
+
+    struct Event
+    {
+        const char *name;
+        std::uint64_t start;
+        std::uint64_t duration;
+    };
+
+    // the ring of one thread, only written by that thread
+    struct ThreadEvents
+    {
+        std::uint32_t threadId;
+        std::vector<Event> ring;
+        std::uint64_t written = 0;
+    };
+
+    struct CounterSample
+    {
+        const char *name;
+        std::uint64_t time;
+        std::uint64_t value;
+    };
+
+    // events kept per thread, the oldest are overwritten
+    static constexpr std::size_t RING_SIZE = 1 << 16;
+
+    std::mutex registryMutex;
+    std::vector<ProfileZoneInfo *> zones;
+    std::vector<ProfileCounterInfo *> counters;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+    // only touched by the thread calling endFrame
+    std::vector<CounterSample> counterSamples;
+    std::uint64_t countersWritten = 0;
+    std::ofstream csv;
+    std::uint64_t frame = 0;
+    std::uint64_t frameStart = 0;
+
+    // the calling thread's ring, created at its first zone
+    ThreadEvents &threadEvents();
+};
+
+// times its scope
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileZoneInfo &zone) : zone(zone), start(Profiler::now()) {}
+
+    ~ProfileScope()
+    {
+        std::uint64_t end = Profiler::now();
+        zone.frameNs.fetch_add(end - start, std::memory_order_relaxed);
+        zone.frameCalls.fetch_add(1, std::memory_order_relaxed);
+        Profiler::get().record(zone, start, end);
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    ProfileZoneInfo &zone;
+    std::uint64_t start;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name)                                                                  \
+    static ProfileZoneInfo PROFILE_CONCAT(profileZoneInfo, __LINE__)(name);                 \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileZoneInfo, __LINE__))
+#define PROFILE_COUNT(name, value)                             \
+    do                                                         \
+    {                                                          \
+        static ProfileCounterInfo profileCounterInfo(name);    \
+        profileCounterInfo.add(static_cast<std::uint64_t>(value)); \
+    } while (0)
+#define PROFILE_FRAME() Profiler::get().endFrame()
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_COUNT(name, value) do { } while (0)
+#define PROFILE_FRAME() do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+std::uint64_t hashSource(const std::string &text, std::uint64_t seed)
+{
+    std::uint64_t hash = seed;
+    for (unsigned char ch : text)
+    {
+        hash ^= ch;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// true if the context exposes the extension
+static bool hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+static std::string glString(GLenum name)
+{
+    const char *value = reinterpret_cast<const char *>(glGetString(name));
+    return value ? value : "";
+}
+
+ProgramCache::ProgramCache(std::string directory, GLADloadproc load) : directory(std::move(directory))
+{
+    driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool coreBinaries = major > 4 || (major == 4 && minor >= 1);
+    if (coreBinaries || hasExtension("GL_ARB_get_program_binary"))
+    {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats > 0)
+        {
+            getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+            programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+            programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+        }
+    }
+
+    if (hasExtension("GL_KHR_parallel_shader_compile"))
+    {
+        maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+    }
+    else if (hasExtension("GL_ARB_parallel_shader_compile"))
+    {
+        maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+    }
+    // let the driver pick the number of compiler threads
+    if (maxShaderCompilerThreads) maxShaderCompilerThreads(0xFFFFFFFFu);
+}
+
+std::shared_ptr<Shader> ProgramCache::add(const char *vertexPath, const char *fragmentPath)
+{
+    PendingProgram program;
+    program.shader = std::shared_ptr<Shader>(new Shader());
+    program.vertexSource = Shader::readSource(vertexPath);
+    program.fragmentSource = Shader::readSource(fragmentPath);
+
+    // the key covers both stages and the driver
+    std::uint64_t key = hashSource(program.vertexSource);
+    key = hashSource(program.fragmentSource, key);
+    key = hashSource(driver, key);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    program.cachePath = directory + "/" + name;
+
+    pending.push_back(std::move(program));
+    return pending.back().shader;
+}
+
+bool ProgramCache::loadBinary(PendingProgram &program)
+{
+    std::ifstream file(program.cachePath, std::ios::binary);
+    if (!file) return false;
+    GLenum format = 0;
+    if (!file.read(reinterpret_cast<char *>(&format), sizeof(format))) return false;
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) return false;
+
+    GLuint id = glCreateProgram();
+    programBinary(id, format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint success = 0;
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // a driver update can reject binaries, the program is compiled again
+        glDeleteProgram(id);
+        return false;
+    }
+    program.shader->ID = id;
+    return true;
+}
+
+void ProgramCache::saveBinary(const PendingProgram &program)
+{
+    GLint length = 0;
+    glGetProgramiv(program.shader->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    getProgramBinary(program.shader->ID, length, nullptr, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::ofstream file(program.cachePath, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Can't write the shader cache " << program.cachePath << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    file.write(binary.data(), binary.size());
+}
+
+void ProgramCache::build()
+{
+    hits = misses = 0;
+    std::vector<PendingProgram *> compiled;
+
+    // issue every compile and link first, without asking for any result
+    for (PendingProgram &program : pending)
+    {
+        if (binariesSupported() && loadBinary(program))
+        {
+            hits++;
+            continue;
+        }
+        misses++;
+        program.vertex = Shader::compileStage(GL_VERTEX_SHADER, program.vertexSource);
+        program.fragment = Shader::compileStage(GL_FRAGMENT_SHADER, program.fragmentSource);
+        GLuint id = glCreateProgram();
+        if (binariesSupported()) programParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(id, program.vertex);
+        glAttachShader(id, program.fragment);
+        glLinkProgram(id);
+        program.shader->ID = id;
+        compiled.push_back(&program);
+    }
+
+    // then collect the results, the status queries block until each program is done
+    for (PendingProgram *program : compiled)
+    {
+        GLuint id = program->shader->ID;
+        bool success = Shader::checkLink(id);
+        if (!success)
+        {
+            Shader::checkCompile(program->vertex, "VERTEX");
+            Shader::checkCompile(program->fragment, "FRAGMENT");
+        }
+        glDeleteShader(program->vertex);
+        glDeleteShader(program->fragment);
+        if (success && binariesSupported()) saveBinary(*program);
+    }
+
+    for (PendingProgram &program : pending)
+    {
+        program.shader->reflectUniforms();
+    }
+    pending.clear();
+}
@@ -0,0 +1,82 @@
+#ifndef CORE_PROGRAM_CACHE_H
+#define CORE_PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+// entry points of GL_ARB_get_program_binary (core in GL 4.1) and
+//      GL_KHR_parallel_shader_compile. Our glad only loads GL 3.3 core, so they
+//      are fetched by hand and left null when the driver doesn't have them
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void *, GLsizei);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint);
+
+// builds the shader programs at startup, reusing the linked binaries of the previous runs.
+//      - programs are queued with add() and built together by build()
+//      - a program whose sources and driver did not change since it was cached
+//        is loaded from its binary, without compiling anything
+//      - the others are compiled together : every compile and link is issued before
+//        the first status query, so drivers compiling in the background
+//        (GL_KHR_parallel_shader_compile) work on all of them at once,
+//        then their binaries are written to the cache for the next run
+//      Without GL_ARB_get_program_binary everything is compiled, still in one batch
+class ProgramCache
+{
+public:
+    // binaries are stored in directory, load is the GL loader (glfwGetProcAddress)
+    //      needs a current context
+    ProgramCache(std::string directory, GLADloadproc load);
+
+    // queue a program, the shader can be used once build() returned
+    std::shared_ptr<Shader> add(const char *vertexPath, const char *fragmentPath);
+
+    // build every queued program
+    void build();
+
+    // how the programs of the last build were obtained
+    int getCacheHits() const { return hits; }
+    int getCacheMisses() const { return misses; }
+
+private:
+    struct PendingProgram
+    {
+        std::shared_ptr<Shader> shader;
+        std::string vertexSource;
+        std::string fragmentSource;
+        std::string cachePath;
+        GLuint vertex = 0;
+        GLuint fragment = 0;
+    };
+
+    std::string directory;
+    std::vector<PendingProgram> pending;
+    int hits = 0;
+    int misses = 0;
+
+    // identifies the driver, a binary is only valid for the driver that produced it
+    std::string driver;
+
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+
+    bool binariesSupported() const { return getProgramBinary && programBinary && programParameteri; }
+
+    // link the program from the cached binary, false if missing or rejected by the driver
+    bool loadBinary(PendingProgram &);
+
+    // write the binary of a linked program to its cache file
+    void saveBinary(const PendingProgram &);
+};
+
+// 64 bit FNV-1a of a string, the cache key of a program
+std::uint64_t hashSource(const std::string &, std::uint64_t seed = 14695981039346656037ull);
+
+#endif
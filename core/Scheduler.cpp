@@ -0,0 +1,101 @@
+#include "Scheduler.h"
+#include "Profiler.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+Scheduler::Scheduler(size_t workerCount) : pool(workerCount)
+{
+}
+
+void Scheduler::addSystem(std::shared_ptr<System> system, std::function<void()> step)
+{
+    tasks.push_back({std::move(system), std::move(step)});
+}
+
+bool Scheduler::conflict(const System &a, const System &b)
+{
+    // both on the main thread : keep their order, GL draw order matters
+    if (a.mainThreadOnly && b.mainThreadOnly) return true;
+    // write/write or read/write on a shared component
+    return (a.writes & (b.reads | b.writes)).any() || (b.writes & a.reads).any();
+}
+
+void Scheduler::run()
+{
+    PROFILE_ZONE("Scheduler::run");
+    const size_t taskCount = tasks.size();
+    if (taskCount == 0) return;
+
+    // build the dependency graph : an edge from each system to every later conflicting one
+    std::vector<size_t> remainingDependencies(taskCount, 0);
+    std::vector<std::vector<size_t>> successors(taskCount);
+    for (size_t later = 0; later < taskCount; ++later)
+    {
+        for (size_t earlier = 0; earlier < later; ++earlier)
+        {
+            if (conflict(*tasks[earlier].system, *tasks[later].system))
+            {
+                successors[earlier].push_back(later);
+                remainingDependencies[later]++;
+            }
+        }
+    }
+
+    // without workers everything runs here
+    const bool runAllHere = pool.workerCount() == 0;
+
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    std::deque<size_t> readyHere;
+    size_t finishedCount = 0;
+
+    // called with stateMutex held
+    std::function<void(size_t)> schedule;
+    std::function<void(size_t)> finish = [&](size_t task) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        for (size_t successor : successors[task])
+        {
+            if (--remainingDependencies[successor] == 0) schedule(successor);
+        }
+        finishedCount++;
+        stateChanged.notify_all();
+    };
+    schedule = [&](size_t task) {
+        if (runAllHere || tasks[task].system->mainThreadOnly)
+        {
+            readyHere.push_back(task);
+            stateChanged.notify_all();
+        }
+        else
+        {
+            pool.submit([&, task] {
+                tasks[task].step();
+                finish(task);
+            });
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        for (size_t task = 0; task < taskCount; ++task)
+        {
+            if (remainingDependencies[task] == 0) schedule(task);
+        }
+    }
+
+    // run the main thread systems as they become ready, until everything is finished
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (finishedCount < taskCount)
+    {
+        stateChanged.wait(lock, [&] { return !readyHere.empty() || finishedCount == taskCount; });
+        if (readyHere.empty()) continue;
+        size_t task = readyHere.front();
+        readyHere.pop_front();
+        lock.unlock();
+        tasks[task].step();
+        finish(task);
+        lock.lock();
+    }
+}
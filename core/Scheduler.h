@@ -0,0 +1,42 @@
+#ifndef CORE_SCHEDULER_H
+#define CORE_SCHEDULER_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "System.h"
+#include "ThreadPool.h"
+
+// runs the frame's systems, concurrently when their declared component access allows it.
+//      The systems are added in the order they would run serially. Every frame a
+//      dependency graph is built from that order : a system waits for each earlier
+//      system it conflicts with (one writes what the other reads or writes).
+//      Systems with mainThreadOnly run on the thread calling run(), in the order they
+//      were added, the others go to the thread pool.
+class Scheduler
+{
+public:
+    explicit Scheduler(size_t workerCount = ThreadPool::defaultWorkerCount());
+
+    // add a system and the call running it for one frame
+    void addSystem(std::shared_ptr<System>, std::function<void()> step);
+
+    // run every system once and return when they are all done
+    void run();
+
+private:
+    struct Task
+    {
+        std::shared_ptr<System> system;
+        std::function<void()> step;
+    };
+
+    std::vector<Task> tasks;
+    ThreadPool pool;
+
+    // true if the two systems can't run at the same time
+    static bool conflict(const System &, const System &);
+};
+
+#endif
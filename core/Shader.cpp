@@ -3,85 +3,124 @@
 Shader::Shader(const char* vertexShaderPath, const char* fragShaderPath)
 {
     // retrieve the shaders' code
+    std::string vertexCode = readSource(vertexShaderPath);
+    std::string fragCode = readSource(fragShaderPath);
 
-    std::string vertexCode;
-    std::string fragCode;
+    // compile shaders, print compile errors if any
+    unsigned int vertex = compileStage(GL_VERTEX_SHADER, vertexCode);
+    checkCompile(vertex, "VERTEX");
+    unsigned int fragment = compileStage(GL_FRAGMENT_SHADER, fragCode);
+    checkCompile(fragment, "FRAGMENT");
 
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+    // shader Program
+    ID = glCreateProgram();
+    glAttachShader(ID, vertex);
+    glAttachShader(ID, fragment);
+    glLinkProgram(ID);
+    // print linking errors if any
+    checkLink(ID);
+
+    // delete the shaders as they're linked into our program now and no longer necessary
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    reflectUniforms();
+}
+
+std::string Shader::readSource(const char *path)
+{
+    std::ifstream file;
     // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     try
     {
-        // open files
-        vShaderFile.open(vertexShaderPath);
-        fShaderFile.open(fragShaderPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragCode = fShaderStream.str();
+        file.open(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        file.close();
+        return stream.str();
     }
     catch (const std::ios_base::failure &e)
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << e.what() << std::endl;
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << " " << e.what() << std::endl;
     }
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
+    return std::string();
+}
+
+GLuint Shader::compileStage(GLenum type, const std::string &source)
+{
+    const char *code = source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+bool Shader::checkCompile(GLuint shader, const char *stageName)
+{
     int success;
     char infoLog[512];
-
-    // vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    // print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n"
                   << infoLog << std::endl;
-    };
-
-    // similiar for Fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    // print compile errors if any
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
-    };
+    }
+    return success;
+}
 
-    // shader Program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    // print linking errors if any
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+bool Shader::checkLink(GLuint program)
+{
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
                   << infoLog << std::endl;
     }
+    return success;
+}
 
-    // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+void Shader::reflectUniforms()
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+        std::string uniform(name.data(), length);
+
+        // members of uniform blocks have no location, they are set through the buffer
+        GLint location = glGetUniformLocation(ID, uniform.c_str());
+        if (location < 0) continue;
+
+        // arrays are reported as name[0], keep them under name as glGetUniformLocation does
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+        {
+            uniform.resize(uniform.size() - 3);
+        }
+        uniformLocations[uniform] = location;
+    }
+}
+
+GLint Shader::getUniformLocation(const std::string &name) const
+{
+    auto it = uniformLocations.find(name);
+    return it == uniformLocations.end() ? -1 : it->second;
+}
+
+void Shader::bindUniformBlock(const std::string &name, GLuint bindingPoint) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(ID, index, bindingPoint);
 }
 
 void Shader::use()
@@ -90,24 +129,43 @@ void Shader::use()
 }
 
 void Shader::setBool(const std::string &name, bool value) const
-{         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+{
+    setBool(getUniformLocation(name), value);
 }
 void Shader::setInt(const std::string &name, int value) const
-{ 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+{
+    setInt(getUniformLocation(name), value);
 }
 void Shader::setFloat(const std::string &name, float value) const
-{ 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+{
+    setFloat(getUniformLocation(name), value);
 }
 void Shader::setTransform(const std::string &name, glm::mat4 value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]); 
-
+    setTransform(getUniformLocation(name), value);
 }
-
 void Shader::setVec4(const std::string &name, glm::vec4 value) const
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    setVec4(getUniformLocation(name), value);
+}
+
+void Shader::setBool(GLint location, bool value) const
+{
+    glUniform1i(location, (int)value);
+}
+void Shader::setInt(GLint location, int value) const
+{
+    glUniform1i(location, value);
+}
+void Shader::setFloat(GLint location, float value) const
+{
+    glUniform1f(location, value);
+}
+void Shader::setTransform(GLint location, glm::mat4 value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+void Shader::setVec4(GLint location, glm::vec4 value) const
+{
+    glUniform4fv(location, 1, &value[0]);
 }
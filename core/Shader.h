@@ -7,6 +7,7 @@
 #include <sstream>
 #include <iostream>
 #include <glm/glm.hpp>
+#include <unordered_map>
 
 struct VAOinfo {
     GLuint VAO;
@@ -18,21 +19,56 @@ class Shader
 {
 public:
     // shader id
-    unsigned int ID;
+    unsigned int ID = 0;
 
     // constructor to read the shaders
     Shader(const char*, const char*);
     // activate the shader using glUseProgram
     void use();
-    // utils uniform functions
+
+    // location of an active uniform, -1 if the program has none by that name.
+    //      every location is read once at link time, so this is a map lookup and
+    //      no GL call. Resolve the uniforms set every frame once and keep the location
+    GLint getUniformLocation(const std::string &name) const;
+
+    // bind the uniform block of that name to a uniform buffer binding point
+    //      (see UniformBuffer), does nothing if the program has no such block
+    void bindUniformBlock(const std::string &name, GLuint bindingPoint) const;
+
+    // utils uniform functions, on the program in use
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
     void setTransform(const std::string &name, glm::mat4 value) const;
     void setVec4(const std::string &name, glm::vec4 value) const;
 
+    // same with a location from getUniformLocation
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+    void setTransform(GLint location, glm::mat4 value) const;
+    void setVec4(GLint location, glm::vec4 value) const;
+
+    // building blocks of the constructor, shared with ProgramCache
+    //      read a whole source file, empty if it can't be read
+    static std::string readSource(const char *path);
+    //      create a shader and start compiling it, without waiting for the result
+    static GLuint compileStage(GLenum type, const std::string &source);
+    //      print the log and return false if a stage or a program failed
+    static bool checkCompile(GLuint shader, const char *stageName);
+    static bool checkLink(GLuint program);
+
+private:
+    friend class ProgramCache;
+
+    // no program yet, ProgramCache fills it in
+    Shader() = default;
 
+    // every active uniform of the linked program, arrays under their bare name
+    std::unordered_map<std::string, GLint> uniformLocations;
 
+    // fill uniformLocations from the linked program
+    void reflectUniforms();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, int tileSize)
+    : width(width), height(height), tileSize(tileSize),
+      tilesX((width + tileSize - 1) / tileSize), tilesY((height + tileSize - 1) / tileSize),
+      tileBins(static_cast<size_t>(tilesX) * tilesY),
+      color(static_cast<size_t>(width) * height),
+      pixels(static_cast<size_t>(width) * height * 4)
+{
+}
+
+void SoftwareRasterizer::setProjection(const glm::mat4 &matrix)
+{
+    projection = matrix;
+}
+
+void SoftwareRasterizer::clear(glm::vec4 fill)
+{
+    clearColor = fill;
+    lines.clear();
+    discs.clear();
+    primitives.clear();
+    for (auto &bin : tileBins) bin.clear();
+}
+
+glm::vec2 SoftwareRasterizer::toPixels(glm::vec2 world) const
+{
+    glm::vec4 clip = projection * glm::vec4(world, 0.0f, 1.0f);
+    return glm::vec2((clip.x * 0.5f + 0.5f) * width, (0.5f - clip.y * 0.5f) * height);
+}
+
+void SoftwareRasterizer::bin(std::uint32_t primitive, glm::vec2 low, glm::vec2 high)
+{
+    if (high.x < 0.0f || high.y < 0.0f || low.x >= width || low.y >= height) return;
+    int tx0 = std::max(0, static_cast<int>(low.x) / tileSize);
+    int ty0 = std::max(0, static_cast<int>(low.y) / tileSize);
+    int tx1 = std::min(tilesX - 1, static_cast<int>(high.x) / tileSize);
+    int ty1 = std::min(tilesY - 1, static_cast<int>(high.y) / tileSize);
+    for (int ty = ty0; ty <= ty1; ++ty)
+    {
+        for (int tx = tx0; tx <= tx1; ++tx) tileBins[ty * tilesX + tx].push_back(primitive);
+    }
+}
+
+void SoftwareRasterizer::addLine(glm::vec2 a, glm::vec2 b, glm::vec4 colorA, glm::vec4 colorB)
+{
+    Line line{toPixels(a), toPixels(b), colorA, colorB};
+    auto primitive = static_cast<std::uint32_t>(primitives.size());
+    primitives.push_back({false, static_cast<std::uint32_t>(lines.size())});
+    lines.push_back(line);
+    // a pixel of margin for the rounding of the stepped positions
+    bin(primitive, glm::min(line.a, line.b) - 1.0f, glm::max(line.a, line.b) + 1.0f);
+}
+
+void SoftwareRasterizer::addDisc(glm::vec2 center, float radius, glm::vec4 discColor)
+{
+    glm::vec2 c = toPixels(center);
+    // radius through the x scale, the projections keep square pixels
+    float r = radius * std::fabs(projection[0][0]) * 0.5f * width;
+    auto primitive = static_cast<std::uint32_t>(primitives.size());
+    primitives.push_back({true, static_cast<std::uint32_t>(discs.size())});
+    discs.push_back({c, r, discColor});
+    bin(primitive, c - r - 1.0f, c + r + 1.0f);
+}
+
+void SoftwareRasterizer::blend(int x, int y, glm::vec4 source)
+{
+    glm::vec4 &destination = color[static_cast<size_t>(y) * width + x];
+    destination = source * source.a + destination * (1.0f - source.a);
+}
+
+void SoftwareRasterizer::drawLine(const Line &line, int x0, int y0, int x1, int y1)
+{
+    // DDA over the whole segment, keeping the steps inside the tile.
+    //      every tile steps the same way so a pixel is drawn once, by its tile
+    glm::vec2 delta = line.b - line.a;
+    int steps = static_cast<int>(std::ceil(std::max(std::fabs(delta.x), std::fabs(delta.y))));
+    if (steps == 0) return;
+
+    // only the steps in the tile, with one step of margin for the rounding
+    float tLow = 0.0f, tHigh = 1.0f;
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        float low = axis == 0 ? x0 - 1.0f : y0 - 1.0f;
+        float high = axis == 0 ? x1 + 1.0f : y1 + 1.0f;
+        float start = line.a[axis], d = delta[axis];
+        if (d == 0.0f)
+        {
+            if (start < low || start > high) return;
+            continue;
+        }
+        float t0 = (low - start) / d, t1 = (high - start) / d;
+        if (t0 > t1) std::swap(t0, t1);
+        tLow = std::max(tLow, t0);
+        tHigh = std::min(tHigh, t1);
+    }
+    if (tLow > tHigh) return;
+
+    // the last point of a segment is the first of the next one in a strip, GL draws it once
+    int first = static_cast<int>(std::floor(tLow * steps));
+    int last = std::min(steps - 1, static_cast<int>(std::ceil(tHigh * steps)));
+    for (int i = first; i <= last; ++i)
+    {
+        float t = static_cast<float>(i) / steps;
+        glm::vec2 p = line.a + t * delta;
+        int x = static_cast<int>(std::floor(p.x));
+        int y = static_cast<int>(std::floor(p.y));
+        if (x < x0 || x > x1 || y < y0 || y > y1) continue;
+        blend(x, y, glm::mix(line.colorA, line.colorB, t));
+    }
+}
+
+void SoftwareRasterizer::drawDisc(const Disc &disc, int x0, int y0, int x1, int y1)
+{
+    int dx0 = std::max(x0, static_cast<int>(std::floor(disc.center.x - disc.radius)));
+    int dy0 = std::max(y0, static_cast<int>(std::floor(disc.center.y - disc.radius)));
+    int dx1 = std::min(x1, static_cast<int>(std::ceil(disc.center.x + disc.radius)));
+    int dy1 = std::min(y1, static_cast<int>(std::ceil(disc.center.y + disc.radius)));
+    float r2 = disc.radius * disc.radius;
+    for (int y = dy0; y <= dy1; ++y)
+    {
+        for (int x = dx0; x <= dx1; ++x)
+        {
+            // pixel centres inside the disc, like GL's coverage rule
+            float px = x + 0.5f - disc.center.x;
+            float py = y + 0.5f - disc.center.y;
+            if (px * px + py * py <= r2) blend(x, y, disc.color);
+        }
+    }
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile)
+{
+    PROFILE_ZONE("SoftwareRasterizer::rasterizeTile");
+    int x0 = (tile % tilesX) * tileSize;
+    int y0 = (tile / tilesX) * tileSize;
+    int x1 = std::min(width, x0 + tileSize) - 1;
+    int y1 = std::min(height, y0 + tileSize) - 1;
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        std::fill(color.begin() + static_cast<size_t>(y) * width + x0,
+                  color.begin() + static_cast<size_t>(y) * width + x1 + 1, clearColor);
+    }
+
+    for (std::uint32_t primitive : tileBins[tile])
+    {
+        const Primitive &p = primitives[primitive];
+        if (p.isDisc) drawDisc(discs[p.index], x0, y0, x1, y1);
+        else drawLine(lines[p.index], x0, y0, x1, y1);
+    }
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            glm::vec4 value = glm::clamp(color[static_cast<size_t>(y) * width + x], 0.0f, 1.0f);
+            std::uint8_t *pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+            for (int k = 0; k < 4; ++k) pixel[k] = static_cast<std::uint8_t>(value[k] * 255.0f + 0.5f);
+        }
+    }
+}
+
+void SoftwareRasterizer::render(ThreadPool &pool)
+{
+    PROFILE_ZONE("SoftwareRasterizer::render");
+    // tiles are handed out one at a time, the caller works as well
+    int tileCount = tilesX * tilesY;
+    std::atomic<int> nextTile{0};
+    auto work = [this, &nextTile, tileCount] {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++) rasterizeTile(tile);
+    };
+
+    std::mutex doneMutex;
+    std::condition_variable doneChanged;
+    size_t helpers = std::min(pool.workerCount(), static_cast<size_t>(tileCount));
+    size_t finished = 0;
+    for (size_t i = 0; i < helpers; ++i)
+    {
+        pool.submit([&] {
+            work();
+            std::lock_guard<std::mutex> lock(doneMutex);
+            finished++;
+            doneChanged.notify_one();
+        });
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneChanged.wait(lock, [&] { return finished == helpers; });
+}
@@ -0,0 +1,94 @@
+#ifndef CORE_SOFTWARE_RASTERIZER_H
+#define CORE_SOFTWARE_RASTERIZER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+// draws lines and discs into an RGBA framebuffer on the CPU, for runs without GL.
+//      Primitives are given in world coordinates and recorded, render() then sorts
+//      them into square tiles and rasterizes the tiles in parallel. A tile draws its
+//      primitives in submission order, so blending matches the GL renderers
+//      (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA). Lines are one pixel wide with the
+//      colour interpolated along them like a GL_LINE_STRIP segment
+class SoftwareRasterizer
+{
+public:
+    SoftwareRasterizer(int width, int height, int tileSize = 64);
+
+    // world to clip space, same matrix as the GL renderers
+    void setProjection(const glm::mat4 &);
+
+    // forget the recorded primitives and fill the framebuffer with the colour at render()
+    void clear(glm::vec4 color);
+
+    // a segment from a to b, the colour goes from colorA to colorB
+    void addLine(glm::vec2 a, glm::vec2 b, glm::vec4 colorA, glm::vec4 colorB);
+
+    // a filled disc
+    void addDisc(glm::vec2 center, float radius, glm::vec4 color);
+
+    // rasterize the recorded primitives, the tiles are shared between the caller and the pool
+    void render(ThreadPool &);
+
+    // the RGBA8 image, rows top to bottom, valid after render()
+    const std::vector<std::uint8_t> &getPixels() const { return pixels; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    struct Line
+    {
+        glm::vec2 a, b; // pixel coordinates
+        glm::vec4 colorA, colorB;
+    };
+
+    struct Disc
+    {
+        glm::vec2 center; // pixel coordinates
+        float radius;     // pixels
+        glm::vec4 color;
+    };
+
+    // a recorded primitive, index in lines or discs
+    struct Primitive
+    {
+        bool isDisc;
+        std::uint32_t index;
+    };
+
+    int width;
+    int height;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+
+    glm::mat4 projection{1.0f};
+    glm::vec4 clearColor{0.0f};
+
+    std::vector<Line> lines;
+    std::vector<Disc> discs;
+    std::vector<Primitive> primitives;
+
+    // per tile, the primitives touching it in submission order
+    std::vector<std::vector<std::uint32_t>> tileBins;
+
+    std::vector<glm::vec4> color; // blending is done in float
+    std::vector<std::uint8_t> pixels;
+
+    // world coordinates to pixels, y going down
+    glm::vec2 toPixels(glm::vec2) const;
+
+    // add the primitive to every tile its bounding box touches
+    void bin(std::uint32_t primitive, glm::vec2 low, glm::vec2 high);
+
+    void rasterizeTile(int tile);
+    void drawLine(const Line &, int x0, int y0, int x1, int y1);
+    void drawDisc(const Disc &, int x0, int y0, int x1, int y1);
+    void blend(int x, int y, glm::vec4 source);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "StreamingBuffer.h"
+
+StreamingBuffer::StreamingBuffer(GLenum target, GLsizeiptr regionSize, int regionCount)
+    : target(target), regionSize(regionSize), regionCount(regionCount), fences(regionCount, nullptr)
+{
+    glGenBuffers(1, &buffer);
+    allocate();
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    for (GLsync fence : fences)
+    {
+        if (fence) glDeleteSync(fence);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void StreamingBuffer::allocate()
+{
+    glBindBuffer(target, buffer);
+    glBufferData(target, regionSize * regionCount, nullptr, GL_STREAM_DRAW);
+}
+
+void *StreamingBuffer::beginFrame(GLsizeiptr size, GLintptr &offset)
+{
+    glBindBuffer(target, buffer);
+
+    if (size > regionSize)
+    {
+        // grow geometrically, orphaning the old storage : the GPU keeps it alive
+        //      for the draws in flight so the fences can be dropped. The buffer
+        //      name does not change so the VAOs reading from it stay valid
+        while (regionSize < size) regionSize *= 2;
+        for (GLsync &fence : fences)
+        {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        allocate();
+    }
+
+    currentRegion = (currentRegion + 1) % regionCount;
+
+    // wait for the draws of regionCount frames ago
+    GLsync &fence = fences[currentRegion];
+    if (fence)
+    {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    offset = regionSize * currentRegion;
+    if (size == 0) return nullptr;
+    void *mapping = glMapBufferRange(target, offset, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    mapped = mapping != nullptr;
+    return mapping;
+}
+
+void StreamingBuffer::endWrite()
+{
+    if (!mapped) return;
+    glBindBuffer(target, buffer);
+    glUnmapBuffer(target);
+    mapped = false;
+}
+
+void StreamingBuffer::endFrame()
+{
+    fences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,55 @@
+#ifndef CORE_STREAMING_BUFFER_H
+#define CORE_STREAMING_BUFFER_H
+
+#include <glad/glad.h>
+#include <vector>
+
+// one large GL buffer used as a ring to stream data every frame without creating GL objects.
+//      The buffer is split in regionCount regions, each frame writes into the next region
+//      through an unsynchronized mapping, and a fence per region makes sure a region is
+//      only written again once the GPU is done drawing from it.
+//      Persistent mapping (GL 4.4) is not available in our GL 3.3 core context, so the
+//      region is mapped and unmapped once per frame instead.
+class StreamingBuffer
+{
+public:
+    // target is GL_ARRAY_BUFFER for vertices, regions of regionSize bytes
+    //      keep regionSize a multiple of the vertex size so regions start on a vertex
+    StreamingBuffer(GLenum target, GLsizeiptr regionSize, int regionCount = 3);
+    ~StreamingBuffer();
+
+    StreamingBuffer(const StreamingBuffer &) = delete;
+    StreamingBuffer &operator=(const StreamingBuffer &) = delete;
+
+    // move to the next region and wait until the GPU is done with it.
+    //      if size bytes don't fit in a region the buffer is reallocated once, bigger
+    //      returns a pointer where size bytes can be written, offset is where they
+    //      start in the buffer. The buffer stays bound to its target.
+    //      Returns nullptr when size is 0 or the mapping failed
+    void *beginFrame(GLsizeiptr size, GLintptr &offset);
+
+    // unmap the region, call it before drawing
+    void endWrite();
+
+    // fence the region, call it after the draws reading it were issued
+    void endFrame();
+
+    GLuint getBuffer() const { return buffer; }
+    GLsizeiptr getRegionSize() const { return regionSize; }
+
+private:
+    GLenum target;
+    GLuint buffer = 0;
+    GLsizeiptr regionSize;
+    int regionCount;
+    int currentRegion = 0;
+    bool mapped = false;
+
+    // one fence per region, 0 when the region is free
+    std::vector<GLsync> fences;
+
+    // create the GL storage for regionCount regions of regionSize bytes
+    void allocate();
+};
+
+#endif
@@ -1,14 +1,27 @@
 #ifndef CORE_SYSTEM_H
 #define CORE_SYSTEM_H
 
-#include <set>
 #include "Entity.h"
+#include "EntitySet.h"
+#include "Component.h"
 
 // every system should inherit that class
 class System
 {
 public:
-    std::set<Entity> listOfEntities;
+    virtual ~System() = default;
+
+    // entities matching the system signature, packed for linear iteration
+    EntitySet listOfEntities;
+
+    // components the system reads and writes, set with Coordinator::setSystemAccess.
+    //      The scheduler runs two systems at the same time only if neither writes
+    //      a component the other one touches
+    Signature reads;
+    Signature writes;
+
+    // systems calling OpenGL set this so the scheduler keeps them on the thread owning the context
+    bool mainThreadOnly = false;
 };
 
-#endif
\ No newline at end of file
+#endif
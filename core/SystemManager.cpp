@@ -1,4 +1,5 @@
 #include "SystemManager.h"
+#include "Profiler.h"
 
 void SystemManager::entityDestroyed(Entity entity)
 {
@@ -38,3 +39,47 @@ void SystemManager::entitySignatureChanged(Entity entity, Signature signature)
     }
 }
 
+
+
+void SystemManager::entitiesSignatureChanged(const Entity *entities, const Signature *entitySignatures, size_t count)
+{
+    PROFILE_ZONE("SystemManager::entitiesSignatureChanged");
+    // system by system so each membership list is updated in one go
+    for (auto const &pair : systems)
+    {
+        auto const &system = pair.second;
+        auto const &systemSignature = signatures[pair.first];
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ((systemSignature & entitySignatures[i]) == systemSignature)
+            {
+                system->listOfEntities.insert(entities[i]);
+            }
+            else
+            {
+                system->listOfEntities.erase(entities[i]);
+            }
+        }
+    }
+}
+
+void SystemManager::entitiesSignatureChanged(const Entity *entities, size_t count, Signature signature)
+{
+    PROFILE_ZONE("SystemManager::entitiesSignatureChanged");
+    for (auto const &pair : systems)
+    {
+        auto const &system = pair.second;
+        auto const &systemSignature = signatures[pair.first];
+
+        // the match only depends on the shared signature
+        if ((systemSignature & signature) == systemSignature)
+        {
+            system->listOfEntities.insert(entities, count);
+        }
+        else
+        {
+            for (size_t i = 0; i < count; ++i) system->listOfEntities.erase(entities[i]);
+        }
+    }
+}
@@ -22,12 +22,23 @@ public:
     template <typename T>
     void setSignature(Signature);
 
+    // set the components a system reads and writes
+    template <typename T>
+    void setAccess(Signature reads, Signature writes);
+
     // erase an entity from all the system lists
     void entityDestroyed(Entity);
 
     // change the signature of an entity
     void entitySignatureChanged(Entity, Signature);
 
+    // change the signatures of count entities at once, entities[i] now has signatures[i]
+    //      each system membership is updated in one pass over the batch
+    void entitiesSignatureChanged(const Entity *entities, const Signature *signatures, size_t count);
+
+    // same as above when the whole batch shares one signature
+    void entitiesSignatureChanged(const Entity *entities, size_t count, Signature);
+
 private:
     // map the name of the systems to their signatures
     std::unordered_map<const char *, Signature> signatures;
@@ -36,8 +47,6 @@ private:
     std::unordered_map<const char *, std::shared_ptr<System>> systems;
 };
 
-#endif
-
 // Template implementations for SystemManager
 template <typename T>
 std::shared_ptr<T> SystemManager::registerSystem()
@@ -55,4 +64,16 @@ void SystemManager::setSignature(Signature signature)
     const char *typeName = typeid(T).name();
     assert(systems.find(typeName) != systems.end() && "Can't find the signature of an unregistered system.");
     signatures.insert({typeName, signature});
-}
\ No newline at end of file
+}
+
+template <typename T>
+void SystemManager::setAccess(Signature reads, Signature writes)
+{
+    const char *typeName = typeid(T).name();
+    auto found = systems.find(typeName);
+    assert(found != systems.end() && "Can't set the access of an unregistered system.");
+    found->second->reads = reads;
+    found->second->writes = writes;
+}
+
+#endif
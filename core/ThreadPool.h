@@ -0,0 +1,45 @@
+#ifndef CORE_THREAD_POOL_H
+#define CORE_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// a fixed set of worker threads pulling jobs from a shared queue
+//      the workers live as long as the pool, so submitting a job never creates a thread
+class ThreadPool
+{
+public:
+    // start the given number of workers, 0 is allowed and means every job
+    //      has to be run by the caller
+    explicit ThreadPool(size_t workerCount);
+
+    // finish the queued jobs and join the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // queue a job for the next free worker
+    void submit(std::function<void()>);
+
+    size_t workerCount() const { return workers.size(); }
+
+    // hardware threads minus the one running the caller
+    static size_t defaultWorkerCount();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobsAvailable;
+    bool stopping = false;
+
+    // the loop run by each worker
+    void workerLoop();
+};
+
+#endif
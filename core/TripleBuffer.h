@@ -0,0 +1,57 @@
+#ifndef CORE_TRIPLE_BUFFER_H
+#define CORE_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// hands the latest value from one writer thread to one reader thread without locks.
+//      Of the three slots the writer owns one, the reader owns one and the third is the
+//      last published. publish() swaps the writer's slot with it, update() swaps the
+//      reader's slot with it when something new was published. Neither side ever waits,
+//      the reader skips the values published in between, and a slot is reused without
+//      reallocating, so T's storage settles after a few frames
+template <class T>
+class TripleBuffer
+{
+public:
+    // writer side : the slot to fill, stale content from three publishes ago
+    T &back() { return slots[backIndex]; }
+
+    // writer side : make back() the newest value and get a free slot for the next one
+    void publish()
+    {
+        std::uint8_t previous = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+        backSkipped = (previous & FRESH_BIT) != 0;
+    }
+
+    // writer side : whether back() holds the last value published, which the reader
+    //      skipped. Otherwise it holds one the reader took, or nothing yet
+    bool isBackSkipped() const { return backSkipped; }
+
+    // reader side : take the newest value if one was published since the last call,
+    //      return false if front() did not change
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT)) return false;
+        std::uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    // reader side : the value taken by the last update()
+    const T &front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr std::uint8_t INDEX_MASK = 0x3;
+    static constexpr std::uint8_t FRESH_BIT = 0x4;
+
+    std::array<T, 3> slots;
+    std::uint8_t backIndex = 0;           // only touched by the writer
+    bool backSkipped = false;             // only touched by the writer
+    std::atomic<std::uint8_t> middle{1};  // the exchanged slot, with FRESH_BIT if unread
+    std::uint8_t frontIndex = 2;          // only touched by the reader
+};
+
+#endif
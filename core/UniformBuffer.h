@@ -0,0 +1,47 @@
+#ifndef CORE_UNIFORM_BUFFER_H
+#define CORE_UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "Profiler.h"
+
+// a uniform buffer holding one T, bound to a fixed binding point so every program
+//      whose block is bound to the same point (Shader::bindUniformBlock) reads it.
+//      Data shared by several programs, like the projection, is then written once
+//      per frame instead of once per program. T must follow the std140 layout of the
+//      block : mat4 and vec4 members are safe, vec3 and scalars need padding
+template <class T>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(GLuint bindingPoint) : bindingPoint(bindingPoint)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformBuffer() { glDeleteBuffers(1, &buffer); }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    // replace the content, the draws issued before still see the old one
+    void update(const T &value)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+        PROFILE_COUNT("uploaded bytes", sizeof(T));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    GLuint getBindingPoint() const { return bindingPoint; }
+
+private:
+    GLuint buffer = 0;
+    GLuint bindingPoint;
+};
+
+#endif
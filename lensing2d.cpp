@@ -3,6 +3,13 @@
 #include <glad/glad.h>
 #include "GLFW/glfw3.h"
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -20,11 +27,20 @@
 #include "systems/RenderTrailSystem.h"
 #include "core/Shader.h"
 #include "core/Coordinator.h"
+#include "core/Scheduler.h"
+#include "core/UniformBuffer.h"
+#include "core/ProgramCache.h"
+#include "core/FrameRecorder.h"
+#include "core/ImageWriter.h"
+#include "core/SoftwareRasterizer.h"
+#include "core/ThreadPool.h"
+#include "core/TripleBuffer.h"
+#include "core/Profiler.h"
+#include "systems/RenderSnapshot.h"
+#include "scene/SceneLoader.h"
 
 #define WIDTH 800
 #define HEIGHT 600
-#define ww 100000000000.0f // 100 billion meters (1e11)
-#define hw 75000000000.0f  // 75 billion meters (7.5e10)
 #define c 299792458.0f     // Speed of light in m/s
 // Global coordinator instance referenced by systems via `extern Coordinator coordinator;`
 Coordinator coordinator;
@@ -32,24 +48,115 @@ Coordinator coordinator;
 
 glm::mat4 projection;
 
-bool isPaused = true;
+// the loaded scene, its world extents set the projection
+SceneInfo scene;
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+// per frame data read by every program through the FrameUniforms block, std140 layout
+struct FrameUniforms
+{
+    glm::mat4 projection;
+};
+const GLuint FRAME_UNIFORMS_BINDING = 0;
+
+// toggled by the key callback, read by the simulation thread
+std::atomic<bool> isPaused{true};
+
+// command line options
+struct Options
+{
+    bool offscreen = false;               // render into an FBO and record the frames
+    bool headless = false;                // no GL at all, the CPU rasterizer writes the images
+    int frames = 600;                     // number of frames to record when offscreen or headless
+    int simRate = 60;                     // simulation steps per second in the window, 0 for no limit
+    std::string output = "frame_%05d.ppm"; // numbered files, or "-" for stdout
+    int width = WIDTH;
+    int height = HEIGHT;
+    std::string profile = "profile";       // PREFIX.csv and PREFIX.json, builds with ASTRO_PROFILE only
+    std::string scene = "scenes/default.scene";
+    std::string exportRays;               // write the scene's rays as a binary ray batch there and quit
+    GeodesicIntegrator integrator = GeodesicIntegrator::Full;
+    int trailSamples = 1;
+};
+
+static void printUsage(const char *program)
+{
+    std::cerr << "usage: " << program << " [--offscreen|--headless] [--frames N] [--output PATTERN|-] [--size WxH] [--profile PREFIX]\n"
+              << "       [--scene FILE] [--export-rays FILE] [--integrator full|reduced|block]\n"
+              << "       [--trail-samples N]\n"
+              << "  --offscreen      render without a visible window and record the frames\n"
+              << "  --headless       simulate and draw on the CPU only, without GL\n"
+              << "  --frames N       number of frames to record (default 600)\n"
+              << "  --output PATTERN printf pattern of the image files (default frame_%05d.ppm),\n"
+              << "                   - streams the frames to stdout for an encoder.\n"
+              << "                   headless, .png names write PNG, and a name without %\n"
+              << "                   only gets the last frame\n"
+              << "  --size WxH       recorded frame size (default " << WIDTH << "x" << HEIGHT << ")\n"
+              << "  --sim-rate N     simulation steps per second in the window (default 60, 0 for no limit)\n"
+              << "  --profile PREFIX profiler output, PREFIX.csv per frame and PREFIX.json for chrome://tracing\n"
+              << "                   (default profile), in builds with -DASTRO_PROFILE\n"
+              << "  --scene FILE     wells and rays to simulate (default scenes/default.scene),\n"
+              << "                   the format is described in scene/SceneLoader.h\n"
+              << "  --export-rays F  write the scene's rays to a binary ray batch and quit\n"
+              << "  --integrator K   full (default) integrates r, phi and both velocities, reduced\n"
+              << "                   keeps the launch E and L and integrates r, phi and dr, block is\n"
+              << "                   reduced with a step per ray from its distance to the hole\n"
+              << "  --trail-samples N\n"
+              << "                   trail positions per update, interpolated between steps (default 1)\n";
+}
+
+// false if the arguments can't be parsed
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--offscreen") options.offscreen = true;
+        else if (arg == "--headless") options.headless = true;
+        else if (arg == "--frames" && hasValue) options.frames = std::atoi(argv[++i]);
+        else if (arg == "--output" && hasValue) options.output = argv[++i];
+        else if (arg == "--sim-rate" && hasValue) options.simRate = std::atoi(argv[++i]);
+        else if (arg == "--profile" && hasValue) options.profile = argv[++i];
+        else if (arg == "--scene" && hasValue) options.scene = argv[++i];
+        else if (arg == "--export-rays" && hasValue) options.exportRays = argv[++i];
+        else if (arg == "--integrator" && hasValue)
+        {
+            std::string kind = argv[++i];
+            if (kind == "full") options.integrator = GeodesicIntegrator::Full;
+            else if (kind == "reduced") options.integrator = GeodesicIntegrator::Reduced;
+            else if (kind == "block") options.integrator = GeodesicIntegrator::Block;
+            else return false;
+        }
+        else if (arg == "--trail-samples" && hasValue) options.trailSamples = std::atoi(argv[++i]);
+        else if (arg == "--size" && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) return false;
+        }
+        else return false;
+    }
+    return options.frames > 0 && options.simRate >= 0 && options.trailSamples > 0 && options.width > 0 && options.height > 0 && !(options.offscreen && options.headless);
+}
 
+// projection showing the whole world in an image of that size, without stretching it
+static glm::mat4 worldProjection(int width, int height)
+{
     float windowAspect = (float)width / (float)height;
-    float worldAspect = ww / hw;
+    float worldAspect = scene.halfWidth / scene.halfHeight;
 
     if (windowAspect > worldAspect) {
         // Window is wider than world -> expand world width
-        float newW = hw * windowAspect;
-        projection = glm::ortho(-newW, newW, -hw, hw, -1.0f, 1.0f);
+        float newW = scene.halfHeight * windowAspect;
+        return glm::ortho(-newW, newW, -scene.halfHeight, scene.halfHeight, -1.0f, 1.0f);
     } else {
         // Window is taller than world -> expand world height
-        float newH = ww / windowAspect;
-        projection = glm::ortho(-ww, ww, -newH, newH, -1.0f, 1.0f);
+        float newH = scene.halfWidth / windowAspect;
+        return glm::ortho(-scene.halfWidth, scene.halfWidth, -newH, newH, -1.0f, 1.0f);
     }
+}
 
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+    projection = worldProjection(width, height);
 }
 
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -64,50 +171,92 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 }
 
 
-int main()
+// what the rays went through, to stderr as stdout may be carrying the frames
+static void printStatistics(const LensingSystem &lensSys)
 {
+    const LensingStatistics &statistics = lensSys.getStatistics();
+    std::cerr << statistics.captured << " rays captured, " << statistics.exits << " left the world, "
+              << statistics.periapsides << " periapsides";
+    if (statistics.periapsides > 0) std::cerr << ", closest approach " << statistics.closestApproach << " m";
+    std::cerr << "\n";
+}
 
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// the frame totals are written as the frames go, the zones of the whole run at the end
+static void startProfile(const Options &options)
+{
+#ifdef ASTRO_PROFILE
+    std::string path = options.profile + ".csv";
+    if (!Profiler::get().openCsv(path)) std::cerr << "Failed to open " << path << std::endl;
+#endif
+}
 
-    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Lensing in 2 dimensions", NULL, NULL);
-    if (window == NULL)
-    {
+// call once every other thread stopped recording
+static void writeProfile(const Options &options)
+{
+#ifdef ASTRO_PROFILE
+    std::string path = options.profile + ".json";
+    if (!Profiler::get().writeChromeTrace(path)) std::cerr << "Failed to write " << path << std::endl;
+#endif
+}
 
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        exit(EXIT_FAILURE);
+// run the simulation without GL : the frames are drawn by the CPU rasterizer,
+//      from the same component arrays the GL renderers read
+static int runHeadless(const Options &options, LensingSystem &lensSys, RenderSpheresSystem &sphereSys,
+                       RenderTrailSystem &trailSys)
+{
+    RenderSnapshot snapshot;
+    ThreadPool pool(ThreadPool::defaultWorkerCount());
+    SoftwareRasterizer rasterizer(options.width, options.height);
+    rasterizer.setProjection(worldProjection(options.width, options.height));
+
+    // without a frame number in the name only the last frame is worth drawing
+    bool sequence = options.output == "-" || options.output.find('%') != std::string::npos;
+    for (int frame = 0; frame < options.frames; ++frame)
+    {
+        PROFILE_FRAME();
+        lensSys.update(1.5f);
+        coordinator.flushCommands();
+        if (!sequence && frame + 1 < options.frames) continue;
+
+        // same snapshots and order as the GL frame : black hole, then trails over it
+        sphereSys.captureCircles(snapshot.circles);
+        trailSys.captureTrails(snapshot.trails);
+        rasterizer.clear(glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
+        sphereSys.rasterizeCircles(snapshot.circles, rasterizer);
+        trailSys.rasterizeTrails(snapshot.trails, rasterizer);
+        rasterizer.render(pool);
+
+        const std::uint8_t *pixels = rasterizer.getPixels().data();
+        bool written;
+        if (options.output == "-")
+        {
+            written = writePPM(stdout, pixels, options.width, options.height) && std::fflush(stdout) == 0;
+        }
+        else
+        {
+            char path[1024];
+            std::snprintf(path, sizeof(path), options.output.c_str(), frame);
+            written = writeImage(path, pixels, options.width, options.height);
+        }
+        if (!written)
+        {
+            std::cerr << "Failed to write frame " << frame << std::endl;
+            return EXIT_FAILURE;
+        }
     }
+    return EXIT_SUCCESS;
+}
 
-    // Make the OpenGL context current before loading GL function pointers
-    glfwMakeContextCurrent(window);
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
     {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
-        exit(EXIT_FAILURE);
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
     }
-
-    glViewport(0, 0, WIDTH, HEIGHT);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetKeyCallback(window, key_callback);
-    const char *vpath = "shaders/vertexShader.glsl";
-    const char *fpath = "shaders/fragmentShader.glsl";
-    auto sharedShader = std::make_shared<Shader>(vpath, fpath);
-    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-
-    // 4) Create proper orthographic projection that matches our world coordinates
-    float left =   - ww;    // Left edge of world
-    float right =  + ww;   // Right edge of world
-    float bottom = - hw; // Bottom edge of world
-    float top =    + hw;     // Top edge of world
-
-    // Orthographic projection matrix
-    projection = glm::ortho(left, right, bottom, top, -1.0f, 1.0f);
-
-
+    // stdout carries the frames, the messages go to stderr
+    if ((options.offscreen || options.headless) && options.output == "-") std::cout.rdbuf(std::cerr.rdbuf());
 
     // Coordinator of ECS
     coordinator.init();
@@ -128,8 +277,13 @@ int main()
         signature.set(coordinator.getComponentType<Spherical>());
         signature.set(coordinator.getComponentType<GravityWell>()); // Only for black hole
         coordinator.setSystemSignature<RenderSpheresSystem>(signature);
+
+        Signature reads;
+        reads.set(coordinator.getComponentType<Transform2D>());
+        reads.set(coordinator.getComponentType<Spherical>());
+        reads.set(coordinator.getComponentType<Color>());
+        coordinator.setSystemAccess<RenderSpheresSystem>(reads, Signature());
     }
-    sphereSys->setShader(sharedShader);
 
     // Create trail system for photons
     auto trailSys = coordinator.registerSystem<RenderTrailSystem>();
@@ -139,8 +293,20 @@ int main()
         signature.set(coordinator.getComponentType<Trail>());
         signature.set(coordinator.getComponentType<Color>());
         coordinator.setSystemSignature<RenderTrailSystem>(signature);
+
+        Signature reads;
+        reads.set(coordinator.getComponentType<Transform2D>());
+        reads.set(coordinator.getComponentType<Trail>());
+        reads.set(coordinator.getComponentType<Color>());
+        coordinator.setSystemAccess<RenderTrailSystem>(reads, Signature());
     }
-    trailSys->setShader(sharedShader);
+
+    // every ray keeps the trailLength last steps of its path, in one shared block.
+    //      Positions on straight stretches are dropped, so far fewer points than steps
+    //      are needed
+    const float trailLength = 200 * 1.5f * c;
+    auto trailArena = std::make_shared<TrailArena>(64);
+    trailSys->setTrailArena(trailArena);
 
     // register lensing physical system and set its signature (entities with Transform2D)
     auto lensSys = coordinator.registerSystem<LensingSystem>();
@@ -148,55 +314,209 @@ int main()
         Signature lsign;
         lsign.set(coordinator.getComponentType<Transform2D>());
         coordinator.setSystemSignature<LensingSystem>(lsign);
+
+        Signature reads, writes;
+        reads.set(coordinator.getComponentType<GravityWell>());
+        writes.set(coordinator.getComponentType<Transform2D>());
+        writes.set(coordinator.getComponentType<Velocity2D>());
+        writes.set(coordinator.getComponentType<Trail>());
+        writes.set(coordinator.getComponentType<Projectile>());
+        coordinator.setSystemAccess<LensingSystem>(reads, writes);
     }
+    lensSys->setTrailArena(trailArena);
+    lensSys->setIntegrator(options.integrator);
+    lensSys->setTrailSamples(options.trailSamples);
 
+    // 4) Load the wells and rays. stdout may be carrying the frames, so the timing goes to stderr
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!loadScene(options.scene, *trailArena, scene)) return EXIT_FAILURE;
+    std::cerr << "loaded " << scene.wellCount << " wells and " << scene.rayCount << " rays from " << options.scene << " in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() << " s\n";
 
+    if (!options.exportRays.empty())
+    {
+        std::vector<Entity> rays(trailSys->listOfEntities.begin(), trailSys->listOfEntities.end());
+        return writeRayBatch(options.exportRays, rays) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    Entity blackHole = coordinator.createEntity();
-    coordinator.addComponent<Transform2D>(blackHole, {glm::vec2(0.0f, 0.0f)});
-    float rs = 2.0f * G * 8.54e36f / (c * c);             // Schwarzschild radius
-    coordinator.addComponent<Spherical>(blackHole, {rs}); // Visual size matches Schwarzschild radius
-    coordinator.addComponent<Color>(blackHole, {glm::vec4(1.0f, 0.2f, 0.2f, 1.0f)});
-    coordinator.addComponent<GravityWell>(blackHole, {8.54e36f, rs});
+    // quarter of a pixel of trail tolerance, at the window's scale
+    TrailDecimation decimation;
+    decimation.tolerance = 0.25f * 2.0f * scene.halfWidth / WIDTH;
+    decimation.maxLength = trailLength;
+    trailArena->setDecimation(decimation);
 
+    // Orthographic projection matrix that matches the scene's world coordinates
+    projection = glm::ortho(-scene.halfWidth, scene.halfWidth, -scene.halfHeight, scene.halfHeight, -1.0f, 1.0f);
+    lensSys->setBounds(glm::vec2(-scene.halfWidth, -scene.halfHeight), glm::vec2(scene.halfWidth, scene.halfHeight));
 
-    int rayCount = 100;
-    const float yStep = (rayCount > 1) ? (top - bottom) / float(rayCount - 1) : 0.0f;
+    startProfile(options);
+    if (options.headless)
+    {
+        int status = runHeadless(options, *lensSys, *sphereSys, *trailSys);
+        writeProfile(options);
+        printStatistics(*lensSys);
+        return status;
+    }
 
-    for (int i = 0; i < rayCount; ++i)
+#ifdef GLFW_PLATFORM_NULL
+    // no display server on the render nodes : GLFW's null platform with an OSMesa context
+    if (options.offscreen && !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY"))
+    {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+#endif
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (options.offscreen)
     {
-        float y = bottom + i * yStep; // evenly spaced across full height
-        Entity r = coordinator.createEntity();
-        coordinator.addComponent<Transform2D>(r, {glm::vec2(left, y)});
-        coordinator.addComponent<Velocity2D>(r, {glm::vec2(c, 0.0f)}); // to the right at c
-        Projectile p;
-        p.impactParameter = std::fabs(y);
-        coordinator.addComponent<Projectile>(r, p);
-        coordinator.addComponent<Color>(r, {glm::vec4(1, 1, 0, 1)});
-        coordinator.addComponent<Trail>(r, {});
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+        if (glfwGetPlatform() == GLFW_PLATFORM_NULL) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
     }
 
-    while (!glfwWindowShouldClose(window))
+    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Lensing in 2 dimensions", NULL, NULL);
+    if (window == NULL)
     {
-        glClear(GL_COLOR_BUFFER_BIT);
 
-        sharedShader->use();
-        sharedShader->setTransform("projection", projection);
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+
+    // Make the OpenGL context current before loading GL function pointers
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    glViewport(0, 0, WIDTH, HEIGHT);
+    if (!options.offscreen)
+    {
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetKeyCallback(window, key_callback);
+    }
+    const char *fpath = "shaders/fragmentShader.glsl";
+    // every program is built at once, from the binaries of the last run when possible
+    ProgramCache programCache(".shadercache", (GLADloadproc)glfwGetProcAddress);
+    // trails are rebuilt from their history on the GPU by their own vertex shader
+    auto trailShader = programCache.add("shaders/trailVertexShader.glsl", fpath);
+    // circles are instances of a unit disc, placed by their own vertex shader
+    auto circleShader = programCache.add("shaders/circleVertexShader.glsl", fpath);
+    programCache.build();
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+
+    // written once per frame, seen by both programs
+    auto frameUniforms = std::make_unique<UniformBuffer<FrameUniforms>>(FRAME_UNIFORMS_BINDING);
+    trailShader->bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+    circleShader->bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+
+    sphereSys->setShader(circleShader);
+    trailSys->setShader(trailShader);
+
+    // simulation step, in serial order : physics, then the renderers copy what they draw.
+    //      the captures only read so they wait for the physics, then run side by side
+    TripleBuffer<RenderSnapshot> snapshots;
+    Scheduler scheduler;
+    scheduler.addSystem(lensSys, [&] {
+        if (!isPaused) lensSys->update(1.5f);
+    });
+    scheduler.addSystem(sphereSys, [&] {
+        sphereSys->captureCircles(snapshots.back().circles);
+    });
+    scheduler.addSystem(trailSys, [&] {
+        // only the points the GL thread lacks, which depends on whether it read the slot
+        trailSys->captureTrails(snapshots.back().trails, snapshots.isBackSkipped());
+    });
+    std::uint64_t simulationSteps = 0;
+    auto simulationStep = [&] {
+        scheduler.run();
+        // sync point : apply the structural changes recorded by the systems
+        coordinator.flushCommands();
+        snapshots.back().step = ++simulationSteps;
+        snapshots.publish();
+    };
+
+    // offscreen, the frames go to an FBO of the requested size and run unpaused,
+    //      one simulation step per frame so the recording does not depend on timing
+    std::unique_ptr<FrameRecorder> recorder;
+    if (options.offscreen)
+    {
+        recorder = std::make_unique<FrameRecorder>(options.width, options.height, options.output);
+        framebuffer_size_callback(window, options.width, options.height);
+        isPaused = false;
+    }
+
+    // in the window the simulation has its own thread and pace, this thread only draws
+    //      the newest snapshot. Neither waits for the other
+    std::atomic<bool> running{true};
+    std::thread simulationThread;
+    if (!recorder)
+    {
+        simulationThread = std::thread([&] {
+            auto period = std::chrono::nanoseconds(options.simRate > 0 ? 1000000000 / options.simRate : 0);
+            auto next = std::chrono::steady_clock::now();
+            while (running)
+            {
+                simulationStep();
+                next += period;
+                // paused without a rate limit, don't spin on empty steps
+                if (isPaused && options.simRate == 0) next += std::chrono::milliseconds(1);
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    while (!glfwWindowShouldClose(window))
+    {
+        PROFILE_FRAME();
+        if (recorder) simulationStep();
 
-        if(!isPaused)
+        // nothing new to draw, the last frame stays up. Before the first publish the front
+        //      slot is still empty, so nothing is drawn until then
+        if (!snapshots.update())
         {
-            lensSys->update(1.5f);
+            glfwPollEvents();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
         }
+        const RenderSnapshot &snapshot = snapshots.front();
+
+        if (recorder) recorder->bind();
+        glClear(GL_COLOR_BUFFER_BIT);
 
-        // Render black hole
-        sphereSys->renderCircle(100); // 100 points pour un plus joli cercle
+        frameUniforms->update({projection});
+        sphereSys->setProjection(projection);
 
-        // Render trails
-        trailSys->renderTrails();
+        sphereSys->renderCircle(snapshot.circles, 100); // 100 points pour un plus joli cercle
+        trailSys->renderTrails(snapshot.trails);
 
-        glfwSwapBuffers(window);
+        if (recorder)
+        {
+            recorder->capture();
+            if (recorder->getCapturedFrames() >= options.frames) break;
+        }
+        else
+        {
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
+    running = false;
+    if (simulationThread.joinable()) simulationThread.join();
+    writeProfile(options);
+    printStatistics(*lensSys);
+
+    // GL objects go before the context
+    recorder.reset();
+    trailSys->releaseBuffers();
+    sphereSys->releaseBuffers();
+    frameUniforms.reset();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,306 @@
+#include "SceneLoader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "../core/Coordinator.h"
+#include "../components/Color.h"
+#include "../components/GravityWell.h"
+#include "../components/Projectile.h"
+#include "../components/Spherical.h"
+#include "../components/Transform2D.h"
+#include "../components/Velocity2D.h"
+#include "../systems/LensingSystem.h"
+
+extern Coordinator coordinator;
+
+static const char RAY_BATCH_MAGIC[8] = {'L', '2', 'D', 'R', 'A', 'Y', 'S', '1'};
+static const std::uint32_t RAY_BATCH_COLORS = 1;
+
+// rays per bulk insert
+static const size_t RAY_CHUNK = 1 << 16;
+
+static const glm::vec4 DEFAULT_RAY_COLOR(1.0f, 1.0f, 0.0f, 1.0f);
+static const glm::vec4 DEFAULT_WELL_COLOR(1.0f, 0.2f, 0.2f, 1.0f);
+
+// rays gathered component by component until a chunk is full, then inserted at once
+class RayChunk
+{
+public:
+    RayChunk(TrailArena &trailArena, SceneInfo &info) : trailArena(trailArena), info(info) {}
+
+    // impact parameters are measured from there
+    void setWell(glm::vec2 position) { well = position; }
+
+    // whether count more entities fit in the ECS, next to the scene's wells and rays
+    bool fits(size_t count) const
+    {
+        return info.wellCount + info.rayCount + positions.size() + count <= MAX_ENTITIES;
+    }
+
+    // a batch of count rays follows, so the arena grows once. False if they don't fit
+    bool expect(size_t count)
+    {
+        if (!fits(count)) return false;
+        trailArena.reserve(static_cast<std::uint32_t>(trailArena.getRingCount() + count));
+        size_t capacity = std::min(count, RAY_CHUNK);
+        positions.reserve(capacity);
+        velocities.reserve(capacity);
+        projectiles.reserve(capacity);
+        colors.reserve(capacity);
+        trails.reserve(capacity);
+        return true;
+    }
+
+    // false if the ray doesn't fit
+    bool add(glm::vec2 position, glm::vec2 velocity, glm::vec4 color)
+    {
+        if (!fits(1)) return false;
+        glm::vec2 offset = position - well;
+        float speed = glm::length(velocity);
+        float impactParameter = speed > 0.0f ? std::fabs(offset.x * velocity.y - offset.y * velocity.x) / speed : 0.0f;
+        positions.push_back({position});
+        velocities.push_back({velocity});
+        projectiles.push_back({impactParameter});
+        colors.push_back({color});
+        trails.push_back(trailArena.allocate());
+        if (positions.size() == RAY_CHUNK) flush();
+        return true;
+    }
+
+    void flush()
+    {
+        if (positions.empty()) return;
+        std::vector<Entity> rays = coordinator.createEntities(positions.size());
+        coordinator.addComponents(rays, positions, velocities, projectiles, colors, trails);
+        info.rayCount += rays.size();
+        positions.clear();
+        velocities.clear();
+        projectiles.clear();
+        colors.clear();
+        trails.clear();
+    }
+
+private:
+    TrailArena &trailArena;
+    SceneInfo &info;
+    glm::vec2 well{0.0f};
+    std::vector<Transform2D> positions;
+    std::vector<Velocity2D> velocities;
+    std::vector<Projectile> projectiles;
+    std::vector<Color> colors;
+    std::vector<Trail> trails;
+};
+
+static glm::vec2 directionVelocity(float degrees)
+{
+    float radians = degrees * float(M_PI) / 180.0f;
+    return c * glm::vec2(std::cos(radians), std::sin(radians));
+}
+
+// the numbers of the entry from token first on, count of them and then optionally a colour
+static bool parseNumbers(const std::vector<std::string> &tokens, size_t first, size_t count, float *values,
+                         glm::vec4 &color)
+{
+    if (tokens.size() != first + count && tokens.size() != first + count + 4) return false;
+    for (size_t i = first; i < tokens.size(); ++i)
+    {
+        char *end = nullptr;
+        float value = std::strtof(tokens[i].c_str(), &end);
+        if (*end != '\0' || !std::isfinite(value)) return false;
+        if (i < first + count) values[i - first] = value;
+        else color[static_cast<int>(i - first - count)] = value;
+    }
+    return true;
+}
+
+// COUNT of an emitter, a whole number of rays the ECS has room for
+static bool parseCount(float value, size_t &count)
+{
+    if (value < 0.0f || value != std::floor(value) || value > static_cast<float>(MAX_ENTITIES)) return false;
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+static bool loadRayBatch(const std::string &path, RayChunk &chunk)
+{
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        std::cerr << "Failed to open ray batch " << path << std::endl;
+        return false;
+    }
+
+    char magic[8];
+    std::uint32_t header[2] = {0, 0};
+    bool valid = std::fread(magic, sizeof(magic), 1, file) == 1 && std::fread(header, sizeof(header), 1, file) == 1
+        && std::memcmp(magic, RAY_BATCH_MAGIC, sizeof(magic)) == 0 && header[0] <= MAX_ENTITIES;
+    const std::uint32_t count = header[0];
+    const size_t floatsPerRay = (header[1] & RAY_BATCH_COLORS) ? 8 : 4;
+
+    // read by chunks straight into the ray chunk
+    std::vector<float> buffer;
+    if (valid && !chunk.expect(count))
+    {
+        std::fclose(file);
+        std::cerr << "Ray batch " << path << " of " << count << " rays exceeds MAX_ENTITIES (" << MAX_ENTITIES
+                  << ") with the scene's other entities" << std::endl;
+        return false;
+    }
+    for (std::uint32_t done = 0; valid && done < count;)
+    {
+        size_t rays = std::min<size_t>(RAY_CHUNK, count - done);
+        buffer.resize(rays * floatsPerRay);
+        valid = std::fread(buffer.data(), sizeof(float) * floatsPerRay, rays, file) == rays;
+        for (size_t i = 0; valid && i < rays; ++i)
+        {
+            // a non-finite value would spread through the integrators, as in parseNumbers
+            const float *ray = &buffer[i * floatsPerRay];
+            for (size_t k = 0; k < floatsPerRay; ++k) valid = valid && std::isfinite(ray[k]);
+            if (!valid) break;
+            glm::vec4 color = floatsPerRay == 8 ? glm::vec4(ray[4], ray[5], ray[6], ray[7]) : DEFAULT_RAY_COLOR;
+            valid = chunk.add(glm::vec2(ray[0], ray[1]), glm::vec2(ray[2], ray[3]), color);
+        }
+        done += static_cast<std::uint32_t>(rays);
+    }
+    std::fclose(file);
+    if (!valid) std::cerr << "Invalid or truncated ray batch " << path << std::endl;
+    return valid;
+}
+
+bool loadScene(const std::string &path, TrailArena &trailArena, SceneInfo &info)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open scene " << path << std::endl;
+        return false;
+    }
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    RayChunk chunk(trailArena, info);
+    std::string line;
+    std::vector<std::string> tokens;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.resize(comment);
+        std::istringstream words(line);
+        tokens.clear();
+        for (std::string word; words >> word;) tokens.push_back(word);
+        if (tokens.empty()) continue;
+
+        const std::string &entry = tokens[0];
+        float values[6] = {};
+        glm::vec4 color = DEFAULT_RAY_COLOR;
+        size_t count = 0;
+        bool valid = true;
+        if (entry == "world")
+        {
+            valid = parseNumbers(tokens, 1, 2, values, color) && tokens.size() == 3 && values[0] > 0.0f && values[1] > 0.0f;
+            info.halfWidth = values[0];
+            info.halfHeight = values[1];
+        }
+        else if (entry == "well")
+        {
+            color = DEFAULT_WELL_COLOR;
+            valid = parseNumbers(tokens, 1, 3, values, color) && values[2] > 0.0f && chunk.fits(1);
+            if (valid)
+            {
+                // the rays added so far were measured from the previous well
+                chunk.flush();
+                glm::vec2 position(values[0], values[1]);
+                float rs = 2.0f * G * values[2] / (c * c);
+                Entity well = coordinator.createEntity();
+                coordinator.addComponent<Transform2D>(well, {position});
+                coordinator.addComponent<Spherical>(well, {rs});
+                coordinator.addComponent<Color>(well, {color});
+                coordinator.addComponent<GravityWell>(well, {values[2], rs});
+                chunk.setWell(position);
+                info.wellCount++;
+            }
+        }
+        else if (entry == "ray")
+        {
+            valid = parseNumbers(tokens, 1, 3, values, color);
+            valid = valid && chunk.add(glm::vec2(values[0], values[1]), directionVelocity(values[2]), color);
+        }
+        else if (entry == "emitter" && tokens.size() > 1 && tokens[1] == "line")
+        {
+            valid = parseNumbers(tokens, 2, 6, values, color) && parseCount(values[4], count);
+            glm::vec2 from(values[0], values[1]), to(values[2], values[3]);
+            glm::vec2 velocity = directionVelocity(values[5]);
+            valid = valid && chunk.expect(count);
+            for (size_t i = 0; valid && i < count; ++i)
+            {
+                float t = count > 1 ? float(i) / float(count - 1) : 0.5f;
+                valid = chunk.add(from + (to - from) * t, velocity, color);
+            }
+        }
+        else if (entry == "emitter" && tokens.size() > 1 && tokens[1] == "fan")
+        {
+            valid = parseNumbers(tokens, 2, 5, values, color) && parseCount(values[2], count);
+            valid = valid && chunk.expect(count);
+            for (size_t i = 0; valid && i < count; ++i)
+            {
+                float t = count > 1 ? float(i) / float(count - 1) : 0.5f;
+                valid = chunk.add(glm::vec2(values[0], values[1]), directionVelocity(values[3] + (values[4] - values[3]) * t), color);
+            }
+        }
+        else if (entry == "rays" && tokens.size() == 2)
+        {
+            std::string batch = tokens[1][0] == '/' ? tokens[1] : directory + tokens[1];
+            valid = loadRayBatch(batch, chunk);
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            std::cerr << path << ":" << lineNumber << ": invalid entry \"" << line << "\"" << std::endl;
+            return false;
+        }
+    }
+    chunk.flush();
+    return true;
+}
+
+bool writeRayBatch(const std::string &path, const std::vector<Entity> &rays)
+{
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    std::uint32_t header[2] = {static_cast<std::uint32_t>(rays.size()), RAY_BATCH_COLORS};
+    bool written = std::fwrite(RAY_BATCH_MAGIC, sizeof(RAY_BATCH_MAGIC), 1, file) == 1
+        && std::fwrite(header, sizeof(header), 1, file) == 1;
+
+    std::vector<float> buffer;
+    for (size_t first = 0; written && first < rays.size(); first += RAY_CHUNK)
+    {
+        size_t last = std::min(rays.size(), first + RAY_CHUNK);
+        buffer.clear();
+        for (size_t i = first; i < last; ++i)
+        {
+            glm::vec2 position = coordinator.getComponent<Transform2D>(rays[i]).position;
+            glm::vec2 velocity = coordinator.getComponent<Velocity2D>(rays[i]).velocity;
+            const glm::vec4 &color = coordinator.getComponent<Color>(rays[i]).color;
+            buffer.insert(buffer.end(), {position.x, position.y, velocity.x, velocity.y, color.r, color.g, color.b, color.a});
+        }
+        written = std::fwrite(buffer.data(), sizeof(float), buffer.size(), file) == buffer.size();
+    }
+    if (std::fclose(file) != 0) written = false;
+    if (!written) std::cerr << "Failed to write " << path << std::endl;
+    return written;
+}
@@ -0,0 +1,47 @@
+#ifndef SCENE_SCENE_LOADER_H
+#define SCENE_SCENE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "../core/Entity.h"
+#include "../components/Trail.h"
+
+// scene files : the wells and rays of a run, so scenarios change without recompiling.
+//      Text, one entry per line, # starts a comment, lengths in meters, masses in kg
+//      and directions in degrees from +x :
+//
+//      world HALF_WIDTH HALF_HEIGHT                        area shown around the origin
+//      well X Y MASS [R G B A]                             black hole, drawn at its Schwarzschild radius
+//      ray X Y DIRECTION [R G B A]                         one ray, every ray goes at c
+//      emitter line X0 Y0 X1 Y1 COUNT DIRECTION [R G B A]  COUNT rays evenly spaced on a segment
+//      emitter fan X Y COUNT FROM TO [R G B A]             COUNT rays from a point, directions FROM to TO
+//      rays PATH                                           a binary ray batch, PATH relative to the scene file
+//
+//      A binary ray batch is "L2DRAYS1", uint32 count, uint32 flags (1 : with colours),
+//      then per ray float x, y, vx, vy and with colours float r, g, b, a, little endian
+//      as writeRayBatch writes it.
+//
+//      Rays are generated or read by chunks, each handed to the ECS in one bulk insert, so
+//      neither the file nor a copy of the rays is held whole. The impact parameter of a
+//      ray is taken against the last well declared before it, the origin if none.
+//      An entry that would take the scene's wells and rays past MAX_ENTITIES is an error
+
+// what the scene declared
+struct SceneInfo
+{
+    float halfWidth = 1e11f;
+    float halfHeight = 7.5e10f;
+    size_t wellCount = 0;
+    size_t rayCount = 0;
+};
+
+// create the scene's entities in the global coordinator, each ray with a ring of the
+//      arena. False, after printing where, if the file can't be read or has an error
+bool loadScene(const std::string &path, TrailArena &, SceneInfo &);
+
+// write the position, velocity and colour of these rays as a binary ray batch
+bool writeRayBatch(const std::string &path, const std::vector<Entity> &rays);
+
+#endif
@@ -0,0 +1,19 @@
+#version 330 core
+// unit disc vertex, shared by every circle
+layout (location = 0) in vec2 aUnit;
+// per instance : centre, radius and colour of the circle
+layout (location = 1) in vec2 aCenter;
+layout (location = 2) in float aRadius;
+layout (location = 3) in vec4 aColor;
+
+out vec4 ourColor;
+// per frame data, shared by every program
+layout (std140) uniform FrameUniforms
+{
+   mat4 projection;
+};
+void main()
+{
+   gl_Position = projection * vec4(aCenter + aRadius * aUnit, 0.0, 1.0);
+   ourColor = aColor;
+}
@@ -0,0 +1,58 @@
+#version 330 core
+// trails are drawn without vertex attributes : everything is fetched from texture buffers.
+//      each trail is drawn from first vertex slot * ringLength, so the vertex id gives
+//      the trail slot and the rank k of the vertex, 0 being the head
+uniform samplerBuffer history;   // RGBA32F, the rings of every trail back to back : x, y, trail length
+uniform samplerBuffer trailInfo; // RGBA32F, per slot : head.x, head.y, ring head, point count
+uniform samplerBuffer trailColor; // RGBA32F, per slot colour
+uniform int infoBase;            // first texel of this frame's trailInfo
+uniform int ringLength;
+uniform float maxLength;         // trail length drawn behind the head, 0 for every point
+// per frame data, shared by every program
+layout (std140) uniform FrameUniforms
+{
+   mat4 projection;
+};
+
+out vec4 ourColor;
+
+// i-th point of the slot's trail, 0 is the oldest
+vec3 trailPoint(int slot, int ringHead, int count, int i)
+{
+   int index = (ringHead + ringLength - count + i) % ringLength;
+   return texelFetch(history, slot * ringLength + index).xyz;
+}
+
+void main()
+{
+   int slot = gl_VertexID / ringLength;
+   int k = gl_VertexID - slot * ringLength;
+   vec4 info = texelFetch(trailInfo, infoBase + slot);
+   int ringHead = int(info.z);
+   int count = int(info.w);
+
+   // the points are spaced by the decimation, so the fade follows the length
+   //      behind the head rather than the point rank
+   vec3 newest = trailPoint(slot, ringHead, count, count - 1);
+   float headLength = newest.z + distance(info.xy, newest.xy);
+   float cutoff = maxLength > 0.0 ? headLength - maxLength : trailPoint(slot, ringHead, count, 0).z;
+
+   // the head is the ray position, then the history from the newest point
+   vec3 point = vec3(info.xy, headLength);
+   if (k > 0)
+   {
+      int i = count - k;
+      point = trailPoint(slot, ringHead, count, i);
+      if (point.z < cutoff)
+      {
+         // the oldest point lies before the length limit : slide it along its segment up to it
+         vec3 next = i + 1 < count ? trailPoint(slot, ringHead, count, i + 1) : vec3(info.xy, headLength);
+         float t = min((cutoff - point.z) / max(next.z - point.z, 1e-30), 1.0);
+         point = vec3(mix(point.xy, next.xy, t), cutoff);
+      }
+   }
+   float alpha = clamp((point.z - cutoff) / max(headLength - cutoff, 1e-30), 0.0, 1.0);
+
+   gl_Position = projection * vec4(point.xy, 0.0, 1.0);
+   ourColor = vec4(texelFetch(trailColor, slot).rgb, alpha);
+}
@@ -1,6 +1,11 @@
 #include "LensingSystem.h"
+#include "../core/Profiler.h"
+#include <algorithm>
 #include <cmath>
 
+// rays stepped in lockstep by the Block integrator, a multiple of the vector width
+static const int BLOCK_BATCH = 8;
+
 void LensingSystem::geodesicRHS(const GeodesicState& state, float rhs[4], float rs) {
     float r = state.r;
     float dr = state.dr;
@@ -24,6 +29,26 @@ void LensingSystem::geodesicRHS(const GeodesicState& state, float rhs[4], float
     rhs[3] = -2.0f * dr * dphi / r;
 }
 
+void LensingSystem::reducedRHS(float r, float dr, float L, float rhs[3], float rs) {
+    // dφ/dl = L / r², kept apart as L² / r⁴ overflows a float
+    float dphi = L / (r*r);
+
+    // dr/dl = dr
+    rhs[0] = dr;
+
+    rhs[1] = dphi;
+
+    // d²r/dl² = L² (r - 3 rs / 2) / r⁴, the full equation once dr² = E² - f L² / r² is used
+    rhs[2] = dphi * dphi * (r - 1.5f * rs);
+}
+
+void LensingSystem::computeConserved(GeodesicState& state, float rs) {
+    // null geodesic : f (dt/dl)^2 = dr^2 / f + r^2 dphi^2, and E = f dt/dl
+    float f = 1.0f - rs/state.r;
+    state.L = state.r * state.r * state.dphi;
+    state.E = std::sqrt(state.dr*state.dr + f * state.r*state.r * state.dphi*state.dphi);
+}
+
 void LensingSystem::addState(const float a[4], const float b[4], float factor, float out[4]) {
     for (int i = 0; i < 4; i++) {
         out[i] = a[i] + b[i] * factor;
@@ -61,16 +86,198 @@ void LensingSystem::rk4Step(GeodesicState& state, float dl, float rs) {
     state.dphi += (dl/6.0f)*(k1[3] + 2*k2[3] + 2*k3[3] + k4[3]);
 }
 
-void LensingSystem::updatePosition(Transform2D& pos, Velocity2D& vel, GeodesicState& state) {
-    // Convert polar coordinates back to Cartesian
-    pos.position.x = state.r * cos(state.phi);
-    pos.position.y = state.r * sin(state.phi);
+// dr moved back onto the null constraint dr² + f L² / r² = E², with the direction of the
+//      integrated dr. Only where dr² stands clear of the float noise of E² : around a
+//      turning point it is the difference of two nearly equal terms, there the
+//      integrated dr is kept as is
+static float projectRadial(float dr, float r, float E, float L, float rs) {
+    float f = 1.0f - rs/r;
+    float tangential = L / r;
+    float dr2 = E * E - f * tangential * tangential;
+    return dr2 > 1e-3f * E * E ? std::copysign(std::sqrt(dr2), dr) : dr;
+}
+
+void LensingSystem::rk4StepReduced(GeodesicState& state, float dl, float rs) {
+    float k1[3], k2[3], k3[3], k4[3];
+
+    // the right hand side only depends on r and dr, phi is carried along
+    reducedRHS(state.r, state.dr, state.L, k1, rs);
+    reducedRHS(state.r + k1[0] * dl/2.0f, state.dr + k1[2] * dl/2.0f, state.L, k2, rs);
+    reducedRHS(state.r + k2[0] * dl/2.0f, state.dr + k2[2] * dl/2.0f, state.L, k3, rs);
+    reducedRHS(state.r + k3[0] * dl, state.dr + k3[2] * dl, state.L, k4, rs);
+
+    state.r   += (dl/6.0f)*(k1[0] + 2*k2[0] + 2*k3[0] + k4[0]);
+    state.phi += (dl/6.0f)*(k1[1] + 2*k2[1] + 2*k3[1] + k4[1]);
+    state.dr   = projectRadial(state.dr + (dl/6.0f)*(k1[2] + 2*k2[2] + 2*k3[2] + k4[2]), state.r, state.E, state.L, rs);
+    state.dphi = state.L / (state.r * state.r);
+}
+
+// RK4 step of the reduced equations for BLOCK_BATCH rays. Every loop runs over the
+//      lanes with no branch, so the compiler turns them into vector instructions
+static void rk4StepReducedBatch(float r[], float phi[], float dr[], const float E[], const float L[], float dl, float rs) {
+    // the stage k evaluates at y + next[k - 1] * k(k - 1), the last offset is unused
+    const float weights[4] = { 1.0f, 2.0f, 2.0f, 1.0f };
+    const float next[4] = { dl/2.0f, dl/2.0f, dl, 0.0f };
+    float stageR[BLOCK_BATCH], stageDr[BLOCK_BATCH];
+    float sumR[BLOCK_BATCH], sumPhi[BLOCK_BATCH], sumDr[BLOCK_BATCH];
+    for (int i = 0; i < BLOCK_BATCH; i++) {
+        stageR[i] = r[i];
+        stageDr[i] = dr[i];
+        sumR[i] = sumPhi[i] = sumDr[i] = 0.0f;
+    }
+    for (int k = 0; k < 4; k++) {
+        for (int i = 0; i < BLOCK_BATCH; i++) {
+            float dphi = L[i] / (stageR[i] * stageR[i]);
+            float ddr = dphi * dphi * (stageR[i] - 1.5f * rs);
+            sumR[i] += weights[k] * stageDr[i];
+            sumPhi[i] += weights[k] * dphi;
+            sumDr[i] += weights[k] * ddr;
+            stageR[i] = r[i] + next[k] * stageDr[i];
+            stageDr[i] = dr[i] + next[k] * ddr;
+        }
+    }
+    for (int i = 0; i < BLOCK_BATCH; i++) {
+        r[i] += (dl/6.0f) * sumR[i];
+        phi[i] += (dl/6.0f) * sumPhi[i];
+        dr[i] = projectRadial(dr[i] + (dl/6.0f) * sumDr[i], r[i], E[i], L[i], rs);
+    }
+}
+
+void LensingSystem::updatePosition(Transform2D& pos, Velocity2D& vel, GeodesicState& state, glm::vec2 center) {
+    // Convert polar coordinates around the well back to Cartesian
+    pos.position.x = center.x + state.r * cos(state.phi);
+    pos.position.y = center.y + state.r * sin(state.phi);
     
     // Update velocity components
     vel.velocity.x = state.dr * cos(state.phi) - state.r * state.dphi * sin(state.phi);
     vel.velocity.y = state.dr * sin(state.phi) + state.r * state.dphi * cos(state.phi);
 }
 
+glm::vec2 LensingSystem::denseOutput(glm::vec2 p0, glm::vec2 v0, glm::vec2 p1, glm::vec2 v1, float dl, float t) {
+    // Hermite basis, the velocities scaled to the interval
+    float t2 = t * t;
+    float t3 = t2 * t;
+    float h00 = 2.0f*t3 - 3.0f*t2 + 1.0f;
+    float h10 = t3 - 2.0f*t2 + t;
+    float h01 = -2.0f*t3 + 3.0f*t2;
+    float h11 = t3 - t2;
+    return h00 * p0 + (h10 * dl) * v0 + h01 * p1 + (h11 * dl) * v1;
+}
+
+// cubic Hermite of a quantity over a step of length dl, from y0 with slope d0 to y1 with slope d1
+static float hermite(float y0, float d0, float y1, float d1, float dl, float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return (2.0f*t3 - 3.0f*t2 + 1.0f) * y0 + (t3 - 2.0f*t2 + t) * dl * d0
+         + (-2.0f*t3 + 3.0f*t2) * y1 + (t3 - t2) * dl * d1;
+}
+
+// its slope along the geodesic parameter
+static float hermiteSlope(float y0, float d0, float y1, float d1, float dl, float t) {
+    float t2 = t * t;
+    return ((6.0f*t2 - 6.0f*t) * (y0 - y1)) / dl + (3.0f*t2 - 4.0f*t + 1.0f) * d0 + (3.0f*t2 - 2.0f*t) * d1;
+}
+
+// the state at fraction t of the step from a to b
+static GeodesicState interpolateStep(const GeodesicState& a, const GeodesicState& b, float dl, float t) {
+    GeodesicState state = a;
+    state.r    = hermite(a.r, a.dr, b.r, b.dr, dl, t);
+    state.phi  = hermite(a.phi, a.dphi, b.phi, b.dphi, dl, t);
+    state.dr   = hermiteSlope(a.r, a.dr, b.r, b.dr, dl, t);
+    state.dphi = hermiteSlope(a.phi, a.dphi, b.phi, b.dphi, dl, t);
+    return state;
+}
+
+static glm::vec2 cartesianPosition(const GeodesicState& state, glm::vec2 center) {
+    return center + state.r * glm::vec2(std::cos(state.phi), std::sin(state.phi));
+}
+
+static glm::vec2 cartesianVelocity(const GeodesicState& state) {
+    glm::vec2 radial(std::cos(state.phi), std::sin(state.phi));
+    glm::vec2 tangential(-radial.y, radial.x);
+    return state.dr * radial + (state.r * state.dphi) * tangential;
+}
+
+// root in [0, 1] of g, whose values g0 at 0 and g1 at 1 have opposite signs. Regula falsi
+//      with the Illinois correction, a handful of evaluations reach float precision
+template <class Function>
+static float findRoot(Function g, float g0, float g1) {
+    float a = 0.0f, b = 1.0f;
+    int kept = 0;  // which end was kept last time, to halve its value when it is kept twice
+    for (int i = 0; i < 12; i++) {
+        float t = (a * g1 - b * g0) / (g1 - g0);
+        float gt = g(t);
+        if (gt == 0.0f || b - a < 1e-6f) return t;
+        if ((gt > 0.0f) == (g1 > 0.0f)) {
+            b = t;
+            g1 = gt;
+            if (kept == -1) g0 *= 0.5f;
+            kept = -1;
+        } else {
+            a = t;
+            g0 = gt;
+            if (kept == 1) g1 *= 0.5f;
+            kept = 1;
+        }
+    }
+    return (a * g1 - b * g0) / (g1 - g0);
+}
+
+bool LensingSystem::detectEvents(Entity ray, const GeodesicState& a, GeodesicState& b, float dl, float time,
+                                 glm::vec2 center, float rs) {
+    // the capture test of update
+    const float horizon = rs + 1e-3f * rs;
+    if (b.r <= horizon) {
+        float t = findRoot([&](float t) { return hermite(a.r, a.dr, b.r, b.dr, dl, t) - horizon; },
+                           a.r - horizon, b.r - horizon);
+        GeodesicState at = interpolateStep(a, b, dl, t);
+        events.push_back({ray, RayEventKind::Horizon, time + t * dl, cartesianPosition(at, center), horizon});
+        statistics.captured++;
+
+        // stopped at the crossing, half the margin in so the capture test can't miss it
+        b = at;
+        b.r = rs + 0.5e-3f * rs;
+        return false;
+    }
+
+    if (a.dr < 0.0f && b.dr >= 0.0f) {
+        float t = findRoot([&](float t) { return hermiteSlope(a.r, a.dr, b.r, b.dr, dl, t); }, a.dr, b.dr);
+        GeodesicState at = interpolateStep(a, b, dl, t);
+        events.push_back({ray, RayEventKind::Periapsis, time + t * dl, cartesianPosition(at, center), at.r});
+        statistics.periapsides++;
+        statistics.closestApproach = std::min(statistics.closestApproach, at.r);
+    }
+
+    // positive out of the bounds, only b is converted unless it is out
+    auto outside = [&](glm::vec2 p) {
+        return std::max(std::max(boundsLower.x - p.x, p.x - boundsUpper.x), std::max(boundsLower.y - p.y, p.y - boundsUpper.y));
+    };
+    if (boundsLower.x < boundsUpper.x && boundsLower.y < boundsUpper.y) {
+        glm::vec2 p1 = cartesianPosition(b, center);
+        float g1 = outside(p1);
+        if (g1 > 0.0f) {
+            glm::vec2 p0 = cartesianPosition(a, center);
+            float g0 = outside(p0);
+            if (g0 <= 0.0f) {
+                glm::vec2 v0 = cartesianVelocity(a), v1 = cartesianVelocity(b);
+                float t = findRoot([&](float t) { return outside(denseOutput(p0, v0, p1, v1, dl, t)); }, g0, g1);
+                glm::vec2 position = denseOutput(p0, v0, p1, v1, dl, t);
+                events.push_back({ray, RayEventKind::Boundary, time + t * dl, position, glm::length(position - center)});
+                statistics.exits++;
+            }
+        }
+    }
+    return true;
+}
+
+void LensingSystem::recordTrail(Trail& trail, glm::vec2 p0, glm::vec2 v0, glm::vec2 p1, glm::vec2 v1, float dt) {
+    // the arena decides whether each position becomes a point
+    for (int s = 1; s < trailSamples; ++s) {
+        trailArena->record(trail, denseOutput(p0, v0, p1, v1, dt, float(s) / float(trailSamples)));
+    }
+    trailArena->record(trail, p1);
+}
+
 glm::vec4 LensingSystem::rhs(glm::vec4 const& r_theta_dr_dtheta, float const& r_s) {
     float r  = r_theta_dr_dtheta[0];
     //float th = r_theta_dr_dtheta[1];
@@ -102,10 +309,10 @@ glm::vec4 LensingSystem::rhs(glm::vec4 const& r_theta_dr_dtheta, float const& r_
 
 
 void LensingSystem::update(float dt) {
+    PROFILE_ZONE("LensingSystem::update");
+    events.clear();
 
-
-    // Integration sub-steps. Tune for stability/perf.
-    const int substeps = 8;
+    // Integration sub-steps, see setSubsteps
     const float h = dt / float(substeps);
 
     Transform2D blackholePos{};
@@ -118,14 +325,28 @@ void LensingSystem::update(float dt) {
         }
     }
 
+    if (integrator == GeodesicIntegrator::Block) updateBlocks(dt, blackholePos.position, blackholeData.r_s);
+
     for (Entity entity : listOfEntities) {
         if (coordinator.hasComponent<GravityWell>(entity)) continue;
+        // already moved by updateBlocks
+        if (integrator == GeodesicIntegrator::Block && coordinator.hasComponent<Projectile>(entity)) continue;
 
         auto &rayPosition = coordinator.getComponent<Transform2D>(entity);
         auto &rayVelocity = coordinator.getComponent<Velocity2D>(entity);
         auto &trail = coordinator.getComponent<Trail>(entity);
+        Projectile *projectile = integrator == GeodesicIntegrator::Reduced && coordinator.hasComponent<Projectile>(entity)
+            ? &coordinator.getComponent<Projectile>(entity) : nullptr;
+        const glm::vec2 startPosition = rayPosition.position;
+        const glm::vec2 startVelocity = rayVelocity.velocity;
 
-        for (int s = 0; s < substeps; ++s) {
+        // captured rays stop moving, their components are then left untouched
+        bool moved = false;
+        if (projectile) {
+            moved = updateReduced(entity, *projectile, rayPosition, rayVelocity, h, blackholePos.position,
+                                  blackholeData.r_s);
+        }
+        for (int s = 0; !projectile && s < substeps; ++s) {
             glm::vec2 relPos = rayPosition.position - blackholePos.position;
 
             GeodesicState state{};
@@ -141,6 +362,10 @@ void LensingSystem::update(float dt) {
             state.dr   = v * std::cos(velAngle - state.phi);
             state.dphi = v * std::sin(velAngle - state.phi) / std::max(state.r, eps);
 
+            // E drives the pull of the hole in geodesicRHS, it must not be left at 0
+            computeConserved(state, blackholeData.r_s);
+            GeodesicState start = state;
+
             // Integrate one small step in "time". Using h here helps a lot.
             rk4Step(state, h, blackholeData.r_s);
 
@@ -149,13 +374,211 @@ void LensingSystem::update(float dt) {
                 !std::isfinite(state.dr) || !std::isfinite(state.dphi))
                 break;
 
+            // a captured ray stops where it crossed the horizon
+            bool free = detectEvents(entity, start, state, h, s * h, blackholePos.position, blackholeData.r_s);
+
             // Update Cartesian position/velocity
-            updatePosition(rayPosition, rayVelocity, state);
+            updatePosition(rayPosition, rayVelocity, state, blackholePos.position);
+            moved = true;
+            if (!free) break;
         }
+        if (!moved) continue;
+
+        // Update trail, with the positions in between if more than one sample is wanted
+        recordTrail(trail, startPosition, startVelocity, rayPosition.position, rayVelocity.velocity, dt);
+
+        // let the renderers know this ray has to be redrawn
+        coordinator.markChanged<Transform2D>(entity);
+        coordinator.markChanged<Velocity2D>(entity);
+        coordinator.markChanged<Trail>(entity);
+    }
+}
+
+bool LensingSystem::updateReduced(Entity entity, Projectile& projectile, Transform2D& pos, Velocity2D& vel, float h,
+                                  glm::vec2 center, float rs) {
+    // polar once, as updateBlocks : rebuilding r, phi and dr from Cartesian floats at every
+    //      substep would put back the error the projection onto E takes out
+    const glm::vec2 relPos = pos.position - center;
+    GeodesicState state{};
+    state.r = glm::length(relPos);
+    if (state.r <= rs + 1e-3f * rs) return false;
+    state.phi = std::atan2(relPos.y, relPos.x);
+    state.dr = glm::dot(relPos, vel.velocity) / state.r;
+    state.dphi = (relPos.x * vel.velocity.y - relPos.y * vel.velocity.x) / (state.r * state.r);
+
+    // E and L of the launch, dphi follows from L
+    if (projectile.E == 0.0f) {
+        computeConserved(state, rs);
+        projectile.E = state.E;
+        projectile.L = state.L;
+        coordinator.markChanged<Projectile>(entity);
+    }
+    state.E = projectile.E;
+    state.L = projectile.L;
+    state.dphi = state.L / (state.r * state.r);
+
+    bool moved = false;
+    for (int s = 0; s < substeps; ++s) {
+        GeodesicState start = state;
+        rk4StepReduced(state, h, rs);
+
+        // a broken down step is dropped, the ray stays where it was
+        if (!std::isfinite(state.r) || !std::isfinite(state.phi) || !std::isfinite(state.dr)) {
+            state = start;
+            break;
+        }
+        moved = true;
+
+        // a captured ray stops where it crossed the horizon
+        if (!detectEvents(entity, start, state, h, s * h, center, rs)) break;
+    }
+    if (moved) updatePosition(pos, vel, state, center);
+    return moved;
+}
+
+int LensingSystem::blockLevel(float r, float E, float dt, float rs, int maxLevel) const {
+    // a ray covers about E dl per step
+    float limit = stepAccuracy * (r - rs);
+    float length = E * dt;
+    int level = 0;
+    while (level < maxLevel && length > limit) {
+        length *= 0.5f;
+        level++;
+    }
+    return level;
+}
+
+void LensingSystem::stepBlockRays(const std::vector<std::uint32_t>& rays, float dl, float time, glm::vec2 center, float rs) {
+    float r[BLOCK_BATCH], phi[BLOCK_BATCH], dr[BLOCK_BATCH], E[BLOCK_BATCH], L[BLOCK_BATCH];
+    for (size_t first = 0; first < rays.size(); first += BLOCK_BATCH) {
+        const int count = static_cast<int>(std::min<size_t>(BLOCK_BATCH, rays.size() - first));
+
+        // gather, the lanes past the end repeat the last ray and are dropped
+        for (int i = 0; i < BLOCK_BATCH; i++) {
+            std::uint32_t ray = rays[first + std::min(i, count - 1)];
+            r[i] = blockR[ray];
+            phi[i] = blockPhi[ray];
+            dr[i] = blockDr[ray];
+            E[i] = blockE[ray];
+            L[i] = blockL[ray];
+        }
+        rk4StepReducedBatch(r, phi, dr, E, L, dl, rs);
+
+        for (int i = 0; i < count; i++) {
+            std::uint32_t ray = rays[first + i];
+            // a broken down step is dropped, the ray stays where it was
+            if (!std::isfinite(r[i]) || !std::isfinite(phi[i]) || !std::isfinite(dr[i])) {
+                blockStopped[ray] = 1;
+                continue;
+            }
+            GeodesicState start{blockR[ray], blockPhi[ray], blockDr[ray], L[i] / (blockR[ray] * blockR[ray]), E[i], L[i]};
+            GeodesicState end{r[i], phi[i], dr[i], L[i] / (r[i] * r[i]), E[i], L[i]};
+            if (!detectEvents(blockEntities[ray], start, end, dl, time, center, rs)) blockStopped[ray] = 1;
+            blockR[ray] = end.r;
+            blockPhi[ray] = end.phi;
+            blockDr[ray] = end.dr;
+        }
+    }
+    PROFILE_COUNT("ray steps", rays.size());
+}
+
+void LensingSystem::updateBlocks(float dt, glm::vec2 center, float rs) {
+    PROFILE_ZONE("LensingSystem::updateBlocks");
+
+    // sub-ticks of the finest level, level k steps every 2^(maxLevel - k) of them
+    int maxLevel = 0;
+    while ((1 << maxLevel) < substeps) maxLevel++;
+    const int ticks = 1 << maxLevel;
+    const float eps = 1e-3f * rs;
+
+    // the rays in polar form, captured ones left out
+    blockEntities.clear();
+    blockR.clear();
+    blockPhi.clear();
+    blockDr.clear();
+    blockE.clear();
+    blockL.clear();
+    blockStartPosition.clear();
+    blockStartVelocity.clear();
+    blockLevelOf.clear();
+    raysDueAt.resize(ticks);
+    for (auto &rays : raysDueAt) rays.clear();
+    raysByLevel.resize(maxLevel + 1);
+    for (Entity entity : listOfEntities) {
+        if (coordinator.hasComponent<GravityWell>(entity) || !coordinator.hasComponent<Projectile>(entity)) continue;
+
+        const glm::vec2 position = coordinator.getComponent<Transform2D>(entity).position;
+        const glm::vec2 relPos = position - center;
+        const glm::vec2 velocity = coordinator.getComponent<Velocity2D>(entity).velocity;
+        GeodesicState state{};
+        state.r = glm::length(relPos);
+        if (state.r <= rs + eps) continue;
+        state.phi = std::atan2(relPos.y, relPos.x);
+        state.dr = glm::dot(relPos, velocity) / state.r;
+        state.dphi = (relPos.x * velocity.y - relPos.y * velocity.x) / (state.r * state.r);
+
+        auto &projectile = coordinator.getComponent<Projectile>(entity);
+        if (projectile.E == 0.0f) {
+            computeConserved(state, rs);
+            projectile.E = state.E;
+            projectile.L = state.L;
+            coordinator.markChanged<Projectile>(entity);
+        }
+
+        int level = blockLevel(state.r, projectile.E, dt, rs, maxLevel);
+        raysDueAt[0].push_back(static_cast<std::uint32_t>(blockEntities.size()));
+        blockEntities.push_back(entity);
+        blockR.push_back(state.r);
+        blockPhi.push_back(state.phi);
+        blockDr.push_back(state.dr);
+        blockE.push_back(projectile.E);
+        blockL.push_back(projectile.L);
+        blockStartPosition.push_back(position);
+        blockStartVelocity.push_back(velocity);
+        blockLevelOf.push_back(static_cast<std::uint8_t>(level));
+    }
+    blockStopped.assign(blockEntities.size(), 0);
+
+    // a ray is only in the list of the sub-tick its last step took it to, so a change of
+    //      level applies from there and every ray ends the update at exactly dt
+    for (int tick = 0; tick < ticks; tick++) {
+        const std::vector<std::uint32_t> &due = raysDueAt[tick];
+        if (due.empty()) continue;
+        for (auto &rays : raysByLevel) rays.clear();
+        for (std::uint32_t ray : due) raysByLevel[blockLevelOf[ray]].push_back(ray);
+        for (int level = 0; level <= maxLevel; level++) {
+            if (raysByLevel[level].empty()) continue;
+            stepBlockRays(raysByLevel[level], dt / float(1 << level), dt * float(tick) / float(ticks), center, rs);
+        }
+
+        // a ray may always move to a finer level, and to a coarser one only once its
+        //      time is a multiple of that coarser step
+        for (std::uint32_t ray : due) {
+            if (blockStopped[ray]) continue;
+            int level = blockLevelOf[ray];
+            const int wanted = blockLevel(blockR[ray], blockE[ray], dt, rs, maxLevel);
+            const int time = tick + (ticks >> level);
+            if (wanted > level) level = wanted;
+            else while (level > wanted && time % (ticks >> (level - 1)) == 0) level--;
+            blockLevelOf[ray] = static_cast<std::uint8_t>(level);
+            if (time < ticks) raysDueAt[time].push_back(ray);
+        }
+    }
+
+    // back to the components
+    for (size_t ray = 0; ray < blockEntities.size(); ray++) {
+        Entity entity = blockEntities[ray];
+        auto &rayPosition = coordinator.getComponent<Transform2D>(entity);
+        auto &rayVelocity = coordinator.getComponent<Velocity2D>(entity);
+        GeodesicState state{blockR[ray], blockPhi[ray], blockDr[ray], blockL[ray] / (blockR[ray] * blockR[ray]),
+                            blockE[ray], blockL[ray]};
+        updatePosition(rayPosition, rayVelocity, state, center);
+
+        recordTrail(coordinator.getComponent<Trail>(entity), blockStartPosition[ray], blockStartVelocity[ray],
+                    rayPosition.position, rayVelocity.velocity, dt);
 
-        // Update trail
-        glm::vec3 poss = glm::vec3(rayPosition.position, 0.0f);
-        trail.trail.push_back(poss);
-        if (trail.trail.size() > 200) trail.trail.erase(trail.trail.begin(), trail.trail.begin() + (trail.trail.size() - 200));
+        coordinator.markChanged<Transform2D>(entity);
+        coordinator.markChanged<Velocity2D>(entity);
+        coordinator.markChanged<Trail>(entity);
     }
 }
@@ -1,6 +1,10 @@
 #ifndef SYSTEMS_LENSING_SYSTEM_H
 #define SYSTEMS_LENSING_SYSTEM_H
 
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstdint>
 #include "glm/glm.hpp"
 #include "../core/System.h"
 #include "../core/Coordinator.h"
@@ -24,18 +28,146 @@ struct GeodesicState {
     float E, L;           // conserved quantities
 };
 
+// how a ray's geodesic is advanced
+//      Full     RK4 on r, phi, dr and dphi, E and L recomputed from the ray every substep
+//      Reduced  E and L fixed at launch, RK4 on r, phi and dr only with dphi = L / r^2,
+//               then dr projected back onto the null constraint. Rays need a Projectile
+//      Block    Reduced with a step per ray : a power-of-two fraction of the update picked
+//               from the ray's distance to the horizon, the finest being 1 / substeps.
+//               Rays due at a sub-tick are stepped together, level by level, in batches
+enum class GeodesicIntegrator {
+    Full,
+    Reduced,
+    Block
+};
+
+// what a ray went through during a step, located within it by root finding on the
+//      step's Hermite interpolation
+//      Horizon    reached r_s, plus the capture margin. The ray is stopped right there
+//      Periapsis  closest approach to the well, dr going from negative to positive
+//      Boundary   left the world bounds
+enum class RayEventKind : std::uint8_t {
+    Horizon,
+    Periapsis,
+    Boundary
+};
+
+struct RayEvent {
+    Entity ray;
+    RayEventKind kind;
+    float time;          // since the start of the update, in the units of dt
+    glm::vec2 position;
+    float r;             // distance to the well
+};
+
+// the events of every update so far, added up
+struct LensingStatistics {
+    size_t captured = 0;
+    size_t periapsides = 0;
+    size_t exits = 0;
+    float closestApproach = INFINITY;  // smallest periapsis distance to the well, captures aside
+};
+
 class LensingSystem : public System
 {
 public:
     void update(float);
+    void setTrailArena(std::shared_ptr<TrailArena> arena) { trailArena = arena; }
+
+    // RK4 steps per update, more is more accurate and slower (default 8).
+    //      With Block, the most a ray can take, rounded up to a power of two
+    void setSubsteps(int count) { substeps = count; }
+    int getSubsteps() const { return substeps; }
+
+    // Full by default
+    void setIntegrator(GeodesicIntegrator kind) { integrator = kind; }
+    GeodesicIntegrator getIntegrator() const { return integrator; }
+
+    // Block : largest step length of a ray as a fraction of its distance to the horizon
+    //      (default 0.02)
+    void setStepAccuracy(float fraction) { stepAccuracy = fraction; }
+    float getStepAccuracy() const { return stepAccuracy; }
+
+    // trail positions recorded per update, evenly spaced in time. The ones between two
+    //      updates come from denseOutput, so trails stay smooth with few large steps (default 1)
+    void setTrailSamples(int count) { trailSamples = count; }
+    int getTrailSamples() const { return trailSamples; }
+
+    // dense output : the position at fraction t in [0, 1] of an interval of length dl that
+    //      goes from p0 at velocity v0 to p1 at velocity v1, by cubic Hermite interpolation.
+    //      Velocities are the derivatives along the geodesic parameter, as in Velocity2D
+    static glm::vec2 denseOutput(glm::vec2 p0, glm::vec2 v0, glm::vec2 p1, glm::vec2 v1, float dl, float t);
+
+    // the box rays leave through Boundary events, none while lower is not below upper
+    void setBounds(glm::vec2 lower, glm::vec2 upper) { boundsLower = lower; boundsUpper = upper; }
+
+    // the events of the last update, in the order they were found
+    const std::vector<RayEvent>& getEvents() const { return events; }
+
+    const LensingStatistics& getStatistics() const { return statistics; }
+
+    // one RK4 step of length dl along the geodesic, public so the integrator can be
+    //      measured and checked on its own
+    void rk4Step(GeodesicState& state, float dl, float rs);
+
+    // one RK4 step of the reduced integrator, E and L of the state are kept as they are
+    void rk4StepReduced(GeodesicState& state, float dl, float rs);
+
+    // fill E and L of a photon state from its position and velocities
+    static void computeConserved(GeodesicState& state, float rs);
 
 private:
     void geodesicRHS(const GeodesicState& state, float rhs[4], float rs);
-    void rk4Step(GeodesicState& state, float dl, float rs);
+    void reducedRHS(float r, float dr, float L, float rhs[3], float rs);
     void addState(const float a[4], const float b[4], float factor, float out[4]);
-    void updatePosition(Transform2D& pos, Velocity2D& vel, GeodesicState& state);
+    void updatePosition(Transform2D& pos, Velocity2D& vel, GeodesicState& state, glm::vec2 center);
+
+    // the substeps of a Reduced update for one ray, in polar form throughout. False if
+    //      it didn't move
+    bool updateReduced(Entity ray, Projectile& projectile, Transform2D& pos, Velocity2D& vel, float h,
+                       glm::vec2 center, float rs);
+
+    // find the events of a step of length dl from state a to state b, which started at
+    //      time in the update. On a Horizon event b is moved onto the crossing and false is
+    //      returned : the ray is captured
+    bool detectEvents(Entity ray, const GeodesicState& a, GeodesicState& b, float dl, float time,
+                      glm::vec2 center, float rs);
+
+    // record the trail samples of an update that took the ray from (p0, v0) to (p1, v1)
+    void recordTrail(Trail& trail, glm::vec2 p0, glm::vec2 v0, glm::vec2 p1, glm::vec2 v1, float dt);
+
+    // the Block integration of every ray with a Projectile around the well at center
+    void updateBlocks(float dt, glm::vec2 center, float rs);
+
+    // step level of a ray at r, the coarsest whose step stays within stepAccuracy
+    int blockLevel(float r, float E, float dt, float rs, int maxLevel) const;
+
+    // one Reduced step of every ray in the list, in batches, starting at time in the update
+    void stepBlockRays(const std::vector<std::uint32_t>& rays, float dl, float time, glm::vec2 center, float rs);
 
     glm::vec4 rhs(glm::vec4 const &r_theta_dr_dtheta, float const &r_s);
+
+    // where the rays' trails are stored, shared with the trail renderer
+    std::shared_ptr<TrailArena> trailArena;
+
+    int substeps = 8;
+    GeodesicIntegrator integrator = GeodesicIntegrator::Full;
+    float stepAccuracy = 0.02f;
+    int trailSamples = 1;
+    glm::vec2 boundsLower{0.0f};
+    glm::vec2 boundsUpper{0.0f};
+    std::vector<RayEvent> events;
+    LensingStatistics statistics;
+
+    // the rays of a Block update in polar form around the well, by index in blockEntities.
+    //      Kept between updates so their storage is reused
+    std::vector<Entity> blockEntities;
+    std::vector<float> blockR, blockPhi, blockDr, blockE, blockL;
+    std::vector<glm::vec2> blockStartPosition, blockStartVelocity; // before the update, for the trail
+    std::vector<std::uint8_t> blockLevelOf;  // current step level
+    std::vector<std::uint8_t> blockStopped;  // reached the horizon or broke down, not stepped anymore
+    std::vector<std::vector<std::uint32_t>> raysDueAt;    // by sub-tick of their next step
+    std::vector<std::vector<std::uint32_t>> raysByLevel;  // the rays due now, by step level
 };
 
 #endif
\ No newline at end of file
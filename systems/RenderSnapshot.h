@@ -0,0 +1,61 @@
+#ifndef SYSTEMS_RENDER_SNAPSHOT_H
+#define SYSTEMS_RENDER_SNAPSHOT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../core/Entity.h"
+#include "../components/Trail.h"
+
+// what the trail renderer needs of one simulation step, copied out of the ECS
+//      so it can be drawn while the simulation moves on
+struct TrailSnapshot
+{
+    // per ray, in the renderer's membership order
+    std::vector<Entity> entities;
+    std::vector<Trail> trails;
+    std::vector<glm::vec2> heads;  // Transform2D position
+    std::vector<glm::vec4> colors;
+
+    // per ray, the Trail::total the renderer already has the points up to. The points
+    //      pushed after it, the newest newPointCount of the trail, are in points, ray after ray
+    std::vector<std::uint32_t> since;
+    std::vector<glm::vec3> points;
+
+    // the layout of the trail arena
+    std::uint32_t ringLength = 0;
+    std::uint32_t ringCount = 0;
+    float maxLength = 0.0f; // TrailDecimation::maxLength
+
+    std::uint32_t newPointCount(size_t ray) const
+    {
+        return std::min(trails[ray].total - since[ray], trails[ray].count);
+    }
+
+    // bumped when a colour or the membership changed
+    std::uint64_t colorVersion = 0;
+};
+
+// what the circle renderer needs of one simulation step
+struct CircleSnapshot
+{
+    std::vector<glm::vec2> centers;
+    std::vector<float> radii;
+    std::vector<glm::vec4> colors;
+
+    // bumped when a circle or the membership changed
+    std::uint64_t version = 0;
+};
+
+// one simulation step as seen by the renderers, passed from the simulation thread
+//      to the GL thread through a TripleBuffer
+struct RenderSnapshot
+{
+    TrailSnapshot trails;
+    CircleSnapshot circles;
+    std::uint64_t step = 0; // simulation steps done
+};
+
+#endif
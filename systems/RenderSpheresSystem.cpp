@@ -1,93 +1,215 @@
 #include "RenderSpheresSystem.h"
 #include "../components/Color.h"
+#include "../core/Profiler.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
 
+// per instance attributes: center (vec2), radius (float) then color (vec4)
+static const GLsizei INSTANCE_FLOATS = 2 + 1 + 4;
+static const GLsizei INSTANCE_STRIDE = INSTANCE_FLOATS * sizeof(GLfloat);
 
+// coarsest tessellation and length of a disc edge on screen, in pixels
+static const int MIN_CIRCLE_POINTS = 8;
+static const float CIRCLE_SEGMENT_PIXELS = 4.0f;
 
-void RenderSpheresSystem::renderCircle(int numPoints)
+// segments needed for edges of about CIRCLE_SEGMENT_PIXELS, rounded up to a power of two
+//      so circles of similar size share a disc, and capped by maxPoints
+static int tessellationFor(float radiusPixels, int maxPoints)
 {
-    for(Entity e : listOfEntities)
+    float wanted = 2.0f * M_PI * radiusPixels / CIRCLE_SEGMENT_PIXELS;
+    int numPoints = MIN_CIRCLE_POINTS;
+    while (numPoints < wanted && numPoints < maxPoints) numPoints *= 2;
+    return std::min(numPoints, maxPoints);
+}
+
+void RenderSpheresSystem::captureCircles(CircleSnapshot &snapshot)
+{
+    PROFILE_ZONE("RenderSpheresSystem::captureCircles");
+    // a new version only if a circle or the membership changed since the last capture
+    ChangeTick since = lastCaptureTick;
+    lastCaptureTick = coordinator.advanceTick();
+    bool changed = capturedEntities.size() != listOfEntities.size()
+        || !std::equal(listOfEntities.begin(), listOfEntities.end(), capturedEntities.begin());
+    for (auto it = listOfEntities.begin(); !changed && it != listOfEntities.end(); ++it)
+    {
+        Entity e = *it;
+        changed = coordinator.hasChangedSince<Transform2D>(e, since)
+            || coordinator.hasChangedSince<Spherical>(e, since)
+            || (coordinator.hasComponent<Color>(e) && coordinator.hasChangedSince<Color>(e, since));
+    }
+    if (changed)
     {
-        auto pos = coordinator.getComponent<Transform2D>(e).position;
-        auto radius = coordinator.getComponent<Spherical>(e).radius;
+        circleVersion++;
+        capturedEntities.assign(listOfEntities.begin(), listOfEntities.end());
+    }
+
+    // the slot may hold an older step, so it is always filled whole
+    snapshot.version = circleVersion;
+    snapshot.centers.clear();
+    snapshot.radii.clear();
+    snapshot.colors.clear();
+    for (Entity e : listOfEntities)
+    {
+        snapshot.centers.push_back(coordinator.getComponent<Transform2D>(e).position);
+        snapshot.radii.push_back(coordinator.getComponent<Spherical>(e).radius);
         glm::vec4 col = glm::vec4(1.0f);
         if (coordinator.hasComponent<Color>(e)) {
             col = coordinator.getComponent<Color>(e).color;
         }
-
-        std::vector<GLfloat> coords = generateCirclePoints(radius, glm::vec3(pos, 0.0f), col, numPoints);
-        VAOinfo vaovbo = setupCircleBuffers(coords);
-
-        shader->use();
-        // compute aspect correction transform so circles look round
-        GLint viewport[4];
-        glGetIntegerv(GL_VIEWPORT, viewport);
-        float aspect = 1.0f;
-        if (viewport[3] != 0) aspect = (float)viewport[2] / (float)viewport[3];
-        // scale X by 1/aspect to compensate for non-square viewport
-        glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / aspect, 1.0f, 1.0f));
-        shader->setTransform("transform", transform);
-
-        glBindVertexArray(vaovbo.VAO);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, numPoints + 2);
-        glBindVertexArray(0);
-
-        glDeleteVertexArrays(1, &vaovbo.VAO);
-        glDeleteBuffers(1, &vaovbo.VBO);
+        snapshot.colors.push_back(col);
     }
-}   
+}
 
-VAOinfo RenderSpheresSystem::setupCircleBuffers(const std::vector<GLfloat> &vertices)
+void RenderSpheresSystem::renderCircle(const CircleSnapshot &snapshot, int numPoints)
 {
-    GLuint VAO, VBO;
+    PROFILE_ZONE("RenderSpheresSystem::renderCircle");
+    if (!discBuffers.VAO) setupCircleBuffers();
+
+    // world units to pixels, read once per frame
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float pixelsPerUnit = 0.5f * (float)viewport[2] * std::fabs(projection[0][0]);
+
+    // the instances only have to be rebuilt if a circle, the membership or the zoom changed
+    bool rebuild = pixelsPerUnit != lastPixelsPerUnit || numPoints != lastNumPoints
+        || snapshot.version != instancedVersion;
+
+    if (rebuild)
+    {
+        lastPixelsPerUnit = pixelsPerUnit;
+        lastNumPoints = numPoints;
+        instancedVersion = snapshot.version;
+
+        // tessellation of each circle, then circles sorted by tessellation
+        std::vector<std::pair<int, size_t>> order;
+        order.reserve(snapshot.radii.size());
+        for (size_t i = 0; i < snapshot.radii.size(); ++i)
+        {
+            order.push_back({tessellationFor(snapshot.radii[i] * pixelsPerUnit, numPoints), i});
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        instanceData.clear();
+        batches.clear();
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            size_t circle = order[i].second;
+            glm::vec2 pos = snapshot.centers[circle];
+            const glm::vec4 &col = snapshot.colors[circle];
+            instanceData.insert(instanceData.end(), {pos.x, pos.y, snapshot.radii[circle], col.r, col.g, col.b, col.a});
+
+            if (batches.empty() || batches.back().numPoints != order[i].first)
+            {
+                discFor(order[i].first);
+                batches.push_back({order[i].first, (GLint)i, 0});
+            }
+            batches.back().instanceCount++;
+        }
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(GLfloat), instanceData.data(), GL_DYNAMIC_DRAW);
+        PROFILE_COUNT("uploaded bytes", instanceData.size() * sizeof(GLfloat));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    shader->use();
+    glBindVertexArray(discBuffers.VAO);
+    for (const InstanceBatch &batch : batches)
+    {
+        bindInstances(batch.firstInstance);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, discFirstVertex[batch.numPoints], batch.numPoints + 2, batch.instanceCount);
+        PROFILE_COUNT("draw calls", 1);
+    }
+    glBindVertexArray(0);
+}   
 
-    glBindVertexArray(VAO);
+void RenderSpheresSystem::setupCircleBuffers()
+{
+    glGenVertexArrays(1, &discBuffers.VAO);
+    glGenBuffers(1, &discBuffers.VBO);
+    glGenBuffers(1, &instanceVBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(discBuffers.VAO);
 
-    // Interleaved attributes: position (vec3) then color (vec4)
-    const GLsizei stride = (3 + 4) * sizeof(GLfloat);
-    // Position attribute (location = 0)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    // Unit disc attribute (location = 0), one per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, discBuffers.VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
     glEnableVertexAttribArray(0);
-    // Color attribute (location = 1)
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
+
+    // Center, radius and color attributes (location = 1, 2, 3), one per instance
+    //      their pointers are set per batch by bindInstances
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (GLuint location = 1; location <= 3; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    bindInstances(0);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
-    return VAOinfo{VAO, VBO};
 }
 
-std::vector<GLfloat> RenderSpheresSystem::generateCirclePoints(float radius, glm::vec3 pos, glm::vec4 color, int numPoints) {
-    // interleaved array: [x,y,z, r,g,b,a, x,y,z, r,g,b,a, ...]
-    std::vector<GLfloat> vertices;
+void RenderSpheresSystem::bindInstances(GLint firstInstance)
+{
+    // no base instance in GL 3.3, so the attributes are pointed at the batch's first instance
+    size_t base = (size_t)firstInstance * INSTANCE_STRIDE;
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE, (void*)base);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE, (void*)(base + 2 * sizeof(GLfloat)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE, (void*)(base + 3 * sizeof(GLfloat)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLint RenderSpheresSystem::discFor(int numPoints)
+{
+    auto found = discFirstVertex.find(numPoints);
+    if (found != discFirstVertex.end()) return found->second;
+
+    // a new tessellation : append it and upload the disc buffer again, this only
+    //      happens the first time a circle needs that many points
+    GLint first = (GLint)(discVertices.size() / 2);
+    generateUnitDisc(discVertices, numPoints);
+    discFirstVertex.insert({numPoints, first});
+
+    glBindBuffer(GL_ARRAY_BUFFER, discBuffers.VBO);
+    glBufferData(GL_ARRAY_BUFFER, discVertices.size() * sizeof(GLfloat), discVertices.data(), GL_STATIC_DRAW);
+    PROFILE_COUNT("uploaded bytes", discVertices.size() * sizeof(GLfloat));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return first;
+}
 
+void RenderSpheresSystem::generateUnitDisc(std::vector<GLfloat> &vertices, int numPoints) {
     // center vertex
-    vertices.push_back(pos.x);
-    vertices.push_back(pos.y);
-    vertices.push_back(pos.z);
-    vertices.push_back(color.r);
-    vertices.push_back(color.g);
-    vertices.push_back(color.b);
-    vertices.push_back(color.a);
+    vertices.push_back(0.0f);
+    vertices.push_back(0.0f);
 
     // ring vertices; include duplicate of first vertex at the end to close the fan
     for (int i = 0; i <= numPoints; i++) {
         float angle = 2.0f * M_PI * i / numPoints;
-        vertices.push_back(pos.x + radius * cos(angle));  // x
-        vertices.push_back(pos.y + radius * sin(angle));  // y
-        vertices.push_back(pos.z);                        // z
-        vertices.push_back(color.r);
-        vertices.push_back(color.g);
-        vertices.push_back(color.b);
-        vertices.push_back(color.a);
+        vertices.push_back(cos(angle));  // x
+        vertices.push_back(sin(angle));  // y
     }
+}
 
-    return vertices;
+void RenderSpheresSystem::releaseBuffers()
+{
+    if (!discBuffers.VAO) return;
+    glDeleteVertexArrays(1, &discBuffers.VAO);
+    glDeleteBuffers(1, &discBuffers.VBO);
+    glDeleteBuffers(1, &instanceVBO);
+    discBuffers = VAOinfo{0, 0};
+    instanceVBO = 0;
+    discVertices.clear();
+    discFirstVertex.clear();
+    instancedVersion = 0;
 }
 
+void RenderSpheresSystem::rasterizeCircles(const CircleSnapshot &snapshot, SoftwareRasterizer &rasterizer)
+{
+    for (size_t i = 0; i < snapshot.centers.size(); ++i)
+    {
+        rasterizer.addDisc(snapshot.centers[i], snapshot.radii[i], snapshot.colors[i]);
+    }
+}
@@ -6,29 +6,84 @@
 #include <GLFW/glfw3.h>
 #include <vector>
 #include <memory>
+#include <map>
 
 #include "../core/System.h"
 #include "../components/Spherical.h"
 #include "../components/Transform2D.h"
 #include "../core/Shader.h"
 #include "../core/Coordinator.h"
+#include "../core/SoftwareRasterizer.h"
+#include "RenderSnapshot.h"
 
 class Coordinator;
 class Shader;
 extern Coordinator coordinator;
 
+// draws every circle as an instance of a cached unit disc, the centre, radius and colour
+//      of each instance come from the Transform2D, Spherical and Color arrays.
+//      The disc tessellation follows the on-screen radius, circles sharing a tessellation
+//      are drawn in a single instanced call.
+//      The arrays are copied into a CircleSnapshot on the simulation side (captureCircles)
+//      and drawn from it on the GL thread (renderCircle)
 class RenderSpheresSystem : public System
 {
 public:
-    
-    void renderCircle(int numPoints = 100);
-    VAOinfo setupCircleBuffers(const std::vector<GLfloat> &);
-    // generate interleaved vertex data: [pos.x,pos.y,pos.z, r,g,b,a, ...]
-    std::vector<GLfloat> generateCirclePoints(float radius, glm::vec3 pos, glm::vec4 color, int numpoints = 100);
+    // copy the circles out of the ECS, runs with the simulation
+    void captureCircles(CircleSnapshot &);
+
+    // numPoints is the tessellation of the largest circles on screen
+    void renderCircle(const CircleSnapshot &, int numPoints = 100);
+    // append a unit disc as a triangle fan [x,y, ...] : centre, then the ring closed on its first vertex
+    void generateUnitDisc(std::vector<GLfloat> &, int numPoints);
     void setShader(std::shared_ptr<Shader> s) {shader = s;};
+    // world to clip transform, used to measure the circles on screen
+    void setProjection(const glm::mat4 &p) {projection = p;};
+
+    // free the GL objects, to call while the context is still alive
+    void releaseBuffers();
+
+    // record the circles into a software rasterizer instead, for runs without GL
+    void rasterizeCircles(const CircleSnapshot &, SoftwareRasterizer &);
 
 private:
     std::shared_ptr<Shader> shader;
+    glm::mat4 projection = glm::mat4(1.0f);
+
+    // unit discs of every tessellation used so far, back to back in discBuffers.VBO
+    //      discFirstVertex[numPoints] is where the fan with numPoints segments starts
+    VAOinfo discBuffers{0, 0};
+    std::vector<GLfloat> discVertices;
+    std::map<int, GLint> discFirstVertex;
+
+    // per instance data [center.x, center.y, radius, r,g,b,a] sorted by tessellation
+    GLuint instanceVBO = 0;
+    std::vector<GLfloat> instanceData;
+
+    // instances sharing a tessellation, drawn together
+    struct InstanceBatch {
+        int numPoints;
+        GLint firstInstance;
+        GLsizei instanceCount;
+    };
+    std::vector<InstanceBatch> batches;
+
+    // capture side : the members and tick of the last capture, and the snapshot version
+    std::vector<Entity> capturedEntities;
+    ChangeTick lastCaptureTick = 0;
+    std::uint64_t circleVersion = 0;
+
+    // what the instance buffer was built from, it is rebuilt only when one of these moved
+    std::uint64_t instancedVersion = 0;
+    float lastPixelsPerUnit = 0.0f;
+    int lastNumPoints = 0;
+
+    // create the VAO and buffers
+    void setupCircleBuffers();
+    // make sure the disc with numPoints segments is in the disc buffer
+    GLint discFor(int numPoints);
+    // point the per instance attributes at the given instance
+    void bindInstances(GLint firstInstance);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,5 +1,6 @@
 #include "RenderTrailSystem.h"
 #include "../core/Coordinator.h"
+#include "../core/Profiler.h"
 #include "../components/Trail.h"
 #include "../components/Color.h"
 
@@ -12,91 +13,366 @@
 
 extern Coordinator coordinator;
 
-void RenderTrailSystem::generateTrailPoints(std::vector<GLfloat>& pointList, std::vector<glm::vec3> trail, glm::vec3 pos, glm::vec4 color)
+// texel sizes of the texture buffers
+static const GLsizeiptr HISTORY_TEXEL_SIZE = 4 * sizeof(GLfloat); // x, y, length, unused
+static const GLsizeiptr INFO_TEXEL_SIZE = 4 * sizeof(GLfloat);    // head.x, head.y, ring head, count
+static const GLsizeiptr COLOR_TEXEL_SIZE = 4 * sizeof(GLfloat);   // r, g, b, a
+
+// texture units of the texture buffers, matching the samplers of the trail shader
+static const GLint HISTORY_UNIT = 0;
+static const GLint INFO_UNIT = 1;
+static const GLint COLOR_UNIT = 2;
+
+void RenderTrailSystem::setUpTrailBuffers()
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &historyBuffer);
+    glGenTextures(1, &historyTexture);
+    glGenBuffers(1, &colorBuffer);
+    glGenTextures(1, &colorTexture);
+
+    // room for about 4k rays per frame before the stream has to grow
+    infoStream = std::make_unique<StreamingBuffer>(GL_TEXTURE_BUFFER, INFO_TEXEL_SIZE * (1 << 12));
+    glGenTextures(1, &infoTexture);
+
+    shader->use();
+    shader->setInt("history", HISTORY_UNIT);
+    shader->setInt("trailInfo", INFO_UNIT);
+    shader->setInt("trailColor", COLOR_UNIT);
+    infoBaseLocation = shader->getUniformLocation("infoBase");
+}
+
+void RenderTrailSystem::setLayout(const TrailSnapshot &snapshot)
 {
+    // the rings on the GPU are laid out for the old length, a new history is started.
+    //      The arena's ring length is set once, this only happens on the first snapshot
+    if (snapshot.ringLength != ringLength) ringCount = 0;
+    ringLength = snapshot.ringLength;
+    maxLength = snapshot.maxLength;
+    shader->use();
+    shader->setInt("ringLength", static_cast<int>(ringLength));
+    shader->setFloat("maxLength", maxLength);
+}
 
-    pointList.push_back(pos.x);
-    pointList.push_back(pos.y);
-    pointList.push_back(pos.z);
-    pointList.push_back(color.x);
-    pointList.push_back(color.y);
-    pointList.push_back(color.z);
-    pointList.push_back(1.0f);
-
-    size_t lengthOfTrail = trail.size();
-    if(lengthOfTrail == 0) return;
-    for(size_t i = lengthOfTrail - 1 ; i > 0; i--)
+void RenderTrailSystem::setShader(std::shared_ptr<Shader> s)
+{
+    shader = s;
+}
+
+void RenderTrailSystem::releaseBuffers()
+{
+    infoStream.reset();
+    if (historyFence) glDeleteSync(historyFence);
+    historyFence = nullptr;
+    GLuint textures[] = {historyTexture, colorTexture, infoTexture};
+    GLuint buffers[] = {historyBuffer, colorBuffer};
+    if (VAO)
     {
-        pointList.push_back(trail[i].x);
-        pointList.push_back(trail[i].y);
-        pointList.push_back(trail[i].z);
-
-        pointList.push_back(color.x);
-        pointList.push_back(color.y);
-        pointList.push_back(color.z);
-        pointList.push_back((float) i / lengthOfTrail);
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(2, buffers);
+        glDeleteVertexArrays(1, &VAO);
     }
-
+    VAO = historyBuffer = historyTexture = colorBuffer = colorTexture = infoTexture = 0;
+    ringCount = ringLength = 0;
 }
 
-VAOinfo RenderTrailSystem::setUpTrailBuffers(const std::vector<GLfloat> &vertices)
+void RenderTrailSystem::growTrailBuffers(const TrailSnapshot &snapshot)
 {
-    GLuint VAO, VBO;
+    PROFILE_ZONE("RenderTrailSystem::growTrailBuffers");
+    const GLsizeiptr oldSize = static_cast<GLsizeiptr>(ringCount) * ringLength * HISTORY_TEXEL_SIZE;
+    ringCount = snapshot.ringCount;
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (static_cast<GLint64>(ringCount) * ringLength > maxTexels)
+    {
+        std::cerr << "Trail history of " << ringCount << " rings exceeds GL_MAX_TEXTURE_BUFFER_SIZE ("
+                  << maxTexels << " texels)" << std::endl;
+    }
 
-    glBindVertexArray(VAO);
+    // a new buffer, the rings already there are copied over on the GPU. The new rings
+    //      are filled by uploadNewPoints, each snapshot has the points the GPU lacks
+    GLuint grown = 0;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(ringCount) * ringLength * HISTORY_TEXEL_SIZE, nullptr,
+                 GL_DYNAMIC_DRAW);
+    if (oldSize > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, historyBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &historyBuffer);
+    historyBuffer = grown;
+    if (historyFence) glDeleteSync(historyFence);
+    historyFence = nullptr;
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_DYNAMIC_DRAW);
+    // the colours are written by the next uploadColors
+    colors.assign(static_cast<size_t>(ringCount) * 4, 0.0f);
+    uploadedColorVersion = 0;
+    glBindBuffer(GL_TEXTURE_BUFFER, colorBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, ringCount * COLOR_TEXEL_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
-    // Interleaved attributes: position (vec3) then color (vec4)
-    const GLsizei stride = (3 + 4) * sizeof(GLfloat);
-    // Position attribute (location = 0)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
-    // Color attribute (location = 1)
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
+    // a texture buffer keeps pointing to its buffer, but attach again after a reallocation
+    glBindTexture(GL_TEXTURE_BUFFER, historyTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, historyBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, colorTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, colorBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    return VAOinfo{VAO, VBO};
+void RenderTrailSystem::uploadNewPoints(const TrailSnapshot &snapshot)
+{
+    PROFILE_ZONE("RenderTrailSystem::uploadNewPoints");
+    if (snapshot.points.empty()) return;
+
+    // the texels about to be written may be the oldest points of the last frame's
+    //      draw, wait for it. It was issued a whole frame ago so this rarely blocks
+    if (historyFence)
+    {
+        GLenum status = glClientWaitSync(historyFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(historyFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        }
+        glDeleteSync(historyFence);
+        historyFence = nullptr;
+    }
+
+    // map the whole history but only flush the written texels, so the driver
+    //      transfers a handful of bytes per ray instead of the buffer
+    glBindBuffer(GL_TEXTURE_BUFFER, historyBuffer);
+    GLfloat *history = static_cast<GLfloat *>(glMapBufferRange(GL_TEXTURE_BUFFER, 0,
+        static_cast<GLsizeiptr>(ringCount) * ringLength * HISTORY_TEXEL_SIZE,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+    if (!history)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        return;
+    }
+    const glm::vec3 *point = snapshot.points.data();
+    for (size_t ray = 0; ray < snapshot.trails.size(); ++ray)
+    {
+        const Trail &trail = snapshot.trails[ray];
+        std::uint32_t pending = snapshot.newPointCount(ray);
+        if (pending == 0) continue;
+
+        // the newest points, at most two runs when they wrap around the ring
+        size_t ringStart = static_cast<size_t>(trail.slot) * ringLength;
+        std::uint32_t index = (trail.head + ringLength - pending) % ringLength;
+        std::uint32_t runStart = index;
+        for (std::uint32_t i = 0; i < pending; ++i, ++point)
+        {
+            GLfloat *texel = history + (ringStart + index) * 4;
+            texel[0] = point->x;
+            texel[1] = point->y;
+            texel[2] = point->z;
+            texel[3] = 0.0f;
+            if (i + 1 == pending || index + 1 == ringLength)
+            {
+                glFlushMappedBufferRange(GL_TEXTURE_BUFFER, (ringStart + runStart) * HISTORY_TEXEL_SIZE,
+                                         (index - runStart + 1) * HISTORY_TEXEL_SIZE);
+                PROFILE_COUNT("uploaded bytes", (index - runStart + 1) * HISTORY_TEXEL_SIZE);
+                runStart = 0;
+            }
+            index = index + 1 == ringLength ? 0 : index + 1;
+        }
+    }
+    glUnmapBuffer(GL_TEXTURE_BUFFER);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 }
 
-void RenderTrailSystem::setShader(std::shared_ptr<Shader> s)
+void RenderTrailSystem::uploadColors(const TrailSnapshot &snapshot)
 {
-    shader = s;
+    if (snapshot.colorVersion == uploadedColorVersion) return;
+    uploadedColorVersion = snapshot.colorVersion;
+    for (size_t ray = 0; ray < snapshot.trails.size(); ++ray)
+    {
+        GLfloat *color = &colors[static_cast<size_t>(snapshot.trails[ray].slot) * 4];
+        const glm::vec4 &col = snapshot.colors[ray];
+        color[0] = col.r;
+        color[1] = col.g;
+        color[2] = col.b;
+        color[3] = 1.0f; // the alpha comes from the fade
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, colorBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, colors.size() * sizeof(GLfloat), colors.data());
+    PROFILE_COUNT("uploaded bytes", colors.size() * sizeof(GLfloat));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 }
 
+void RenderTrailSystem::captureTrails(TrailSnapshot &snapshot, bool skipped)
+{
+    PROFILE_ZONE("RenderTrailSystem::captureTrails");
+    // a new colour version only if a colour or the membership changed since the last capture
+    ChangeTick since = lastCaptureTick;
+    lastCaptureTick = coordinator.advanceTick();
+    bool changed = capturedEntities.size() != listOfEntities.size()
+        || !std::equal(listOfEntities.begin(), listOfEntities.end(), capturedEntities.begin());
+    for (auto it = listOfEntities.begin(); !changed && it != listOfEntities.end(); ++it)
+    {
+        changed = coordinator.hasChangedSince<Color>(*it, since);
+    }
+    if (changed)
+    {
+        colorVersion++;
+        capturedEntities.assign(listOfEntities.begin(), listOfEntities.end());
+    }
+
+    // what the renderer has of each ring, from the step in the slot : all its points if
+    //      the renderer read it, else only what it was captured against. The renderer may
+    //      have newer points still, sending them again is harmless
+    const TrailArena &arena = *trailArena;
+    knownOwners.assign(arena.getRingCount(), NULL_ENTITY);
+    knownTotals.assign(arena.getRingCount(), 0);
+    for (size_t ray = 0; ray < snapshot.trails.size(); ++ray)
+    {
+        const Trail &trail = snapshot.trails[ray];
+        knownOwners[trail.slot] = snapshot.entities[ray];
+        knownTotals[trail.slot] = skipped ? snapshot.since[ray] : trail.total;
+    }
 
+    // the slot is filled whole. The vectors keep their capacity so this settles into
+    //      plain copies, of the points pushed over the last few steps only
+    snapshot.colorVersion = colorVersion;
+    snapshot.ringLength = arena.getRingLength();
+    snapshot.ringCount = arena.getRingCount();
+    snapshot.maxLength = arena.getDecimation().maxLength;
+    snapshot.entities.assign(listOfEntities.begin(), listOfEntities.end());
+    snapshot.trails.clear();
+    snapshot.heads.clear();
+    snapshot.colors.clear();
+    snapshot.since.clear();
+    snapshot.points.clear();
+    for (Entity e : listOfEntities)
+    {
+        const Trail &trail = coordinator.getComponent<Trail>(e);
+        snapshot.trails.push_back(trail);
+        snapshot.heads.push_back(coordinator.getComponent<Transform2D>(e).position);
+        snapshot.colors.push_back(coordinator.getComponent<Color>(e).color);
 
+        // a ring handed to another ray is sent whole
+        std::uint32_t known = knownTotals[trail.slot];
+        if (knownOwners[trail.slot] != e || trail.total < known) known = 0;
+        snapshot.since.push_back(known);
+        for (std::uint32_t i = trail.count - snapshot.newPointCount(snapshot.trails.size() - 1); i < trail.count; ++i)
+        {
+            snapshot.points.push_back(arena.at(trail, i));
+        }
+    }
+}
 
-void RenderTrailSystem::renderTrails()
+void RenderTrailSystem::renderTrails(const TrailSnapshot &snapshot)
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for(Entity e : listOfEntities)
+    PROFILE_ZONE("RenderTrailSystem::renderTrails");
+    // nothing captured yet
+    if (snapshot.ringLength == 0) return;
+    if (!VAO) setUpTrailBuffers();
+    if (snapshot.ringLength != ringLength || snapshot.maxLength != maxLength) setLayout(snapshot);
+
+    if (snapshot.ringCount > ringCount) growTrailBuffers(snapshot);
+    uploadNewPoints(snapshot);
+    uploadColors(snapshot);
+
+    // one info texel per ring, so the shader finds a trail's texel from its slot
+    GLintptr offset = 0;
+    GLfloat *info = static_cast<GLfloat *>(infoStream->beginFrame(ringCount * INFO_TEXEL_SIZE, offset));
+    trailFirsts.clear();
+    trailCounts.clear();
+    if (info)
     {
-        auto pos = coordinator.getComponent<Transform2D>(e).position;
-        auto trail = coordinator.getComponent<Trail>(e).trail;
-        glm::vec4 col = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
-        if (coordinator.hasComponent<Color>(e)) {
-            col = coordinator.getComponent<Color>(e).color;
+        for (size_t ray = 0; ray < snapshot.trails.size(); ++ray)
+        {
+            const Trail &trail = snapshot.trails[ray];
+            glm::vec2 pos = snapshot.heads[ray];
+            GLfloat *texel = info + static_cast<size_t>(trail.slot) * 4;
+            texel[0] = pos.x;
+            texel[1] = pos.y;
+            texel[2] = static_cast<GLfloat>(trail.head);
+            texel[3] = static_cast<GLfloat>(trail.count);
+
+            // the head then the points of history, as many as the slot has vertex ids for
+            if (trail.count == 0) continue;
+            trailFirsts.push_back(static_cast<GLint>(trail.slot * ringLength));
+            trailCounts.push_back(static_cast<GLsizei>(std::min(trail.count + 1, ringLength)));
         }
+    }
+    infoStream->endWrite();
+    PROFILE_COUNT("uploaded bytes", ringCount * INFO_TEXEL_SIZE);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    if (!info) return;
+
+    if (infoRegionSize != infoStream->getRegionSize())
+    {
+        // the stream was reallocated
+        infoRegionSize = infoStream->getRegionSize();
+        glBindTexture(GL_TEXTURE_BUFFER, infoTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, infoStream->getBuffer());
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shader->use();
+    shader->setInt(infoBaseLocation, static_cast<int>(offset / INFO_TEXEL_SIZE));
 
-        std::vector<GLfloat> coords;
-        generateTrailPoints(coords, trail, glm::vec3(pos, 0.0f), col);
-        VAOinfo vaovbo = setUpTrailBuffers(coords);
+    glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, historyTexture);
+    glActiveTexture(GL_TEXTURE0 + INFO_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, infoTexture);
+    glActiveTexture(GL_TEXTURE0 + COLOR_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, colorTexture);
 
-        shader->use();
+    // every trail in one call, each one still its own line strip
+    glBindVertexArray(VAO);
+    glMultiDrawArrays(GL_LINE_STRIP, trailFirsts.data(), trailCounts.data(), static_cast<GLsizei>(trailCounts.size()));
+    PROFILE_COUNT("draw calls", 1);
+    glBindVertexArray(0);
 
-        glBindVertexArray(vaovbo.VAO);
-        glDrawArrays(GL_LINE_STRIP, 0, coords.size()/7);
-        glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
 
-        glDeleteVertexArrays(1, &vaovbo.VAO);
-        glDeleteBuffers(1, &vaovbo.VBO);
+    infoStream->endFrame();
+    historyFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RenderTrailSystem::rasterizeTrails(const TrailSnapshot &snapshot, SoftwareRasterizer &rasterizer)
+{
+    const TrailArena &arena = *trailArena;
+    const float maxLength = snapshot.maxLength;
+    for (size_t ray = 0; ray < snapshot.trails.size(); ++ray)
+    {
+        const Trail &trail = snapshot.trails[ray];
+        if (trail.count == 0) continue;
+        glm::vec2 pos = snapshot.heads[ray];
+        const glm::vec4 &col = snapshot.colors[ray];
+
+        // same vertices as the trail shader : the head at full alpha, then the points
+        //      fading out with their distance behind the head. A point before the length
+        //      limit slides along its segment up to it
+        float headLength = arena.headLength(trail, pos);
+        float cutoff = maxLength > 0.0f ? headLength - maxLength : arena.at(trail, 0).z;
+        float fadeLength = std::max(headLength - cutoff, std::numeric_limits<float>::min());
+        std::uint32_t oldest = trail.count < arena.getRingLength() ? 0 : 1;
+
+        glm::vec2 previous = pos;
+        float previousAlpha = 1.0f;
+        glm::vec3 next = glm::vec3(pos, headLength);
+        for (std::uint32_t i = trail.count; i-- > oldest;)
+        {
+            glm::vec3 point = arena.at(trail, i);
+            if (point.z < cutoff)
+            {
+                float t = (cutoff - point.z) / std::max(next.z - point.z, std::numeric_limits<float>::min());
+                point = glm::vec3(glm::mix(glm::vec2(point), glm::vec2(next), std::min(t, 1.0f)), cutoff);
+            }
+            float alpha = std::clamp((point.z - cutoff) / fadeLength, 0.0f, 1.0f);
+            rasterizer.addLine(previous, glm::vec2(point), glm::vec4(glm::vec3(col), previousAlpha), glm::vec4(glm::vec3(col), alpha));
+            next = arena.at(trail, i);
+            previous = glm::vec2(point);
+            previousAlpha = alpha;
+        }
     }
 }
@@ -4,23 +4,109 @@
 #include <memory>
 #include "../core/System.h"
 #include "../core/Shader.h"
+#include "../core/StreamingBuffer.h"
+#include "../core/SoftwareRasterizer.h"
+#include "RenderSnapshot.h"
 #include <glad/glad.h>
 #include <vector>
 #include "../components/Trail.h"
 #include "../components/Transform2D.h"
 
+// draws the photon trails from a copy of the trail arena kept on the GPU.
+//      the history lives in a texture buffer laid out like the arena (ring k at
+//      k * ringLength), and each frame only the points pushed since the last frame are
+//      uploaded, with one small info texel per ray (head position, ring head, count).
+//      The vertex shader (shaders/trailVertexShader.glsl) fetches the points and derives
+//      the fade from the trail length stored with each point, there are no vertex
+//      attributes at all.
+//      The rays and their new points are copied into a TrailSnapshot on the simulation
+//      side (captureTrails) and drawn from it on the GL thread (renderTrails)
 class RenderTrailSystem : public System {
 public:
-    void renderTrails();
+    // copy the rays out of the ECS with the points the renderer doesn't have yet, runs
+    //      with the simulation. The snapshot's content tells what the renderer has :
+    //      skipped means the renderer never read it, as TripleBuffer::isBackSkipped
+    void captureTrails(TrailSnapshot &, bool skipped = false);
 
-    // generate interleaved vertex data: [pos.x,pos.y,pos.z, r,g,b,a, ...]
-    void generateTrailPoints(std::vector<GLfloat>&, std::vector<glm::vec3>, glm::vec3, glm::vec4);
+    void renderTrails(const TrailSnapshot &);
 
-    VAOinfo setUpTrailBuffers(const std::vector<GLfloat>&);
     void setShader(std::shared_ptr<Shader> shader);
+    void setTrailArena(std::shared_ptr<TrailArena> arena) { trailArena = arena; }
+
+    // free the GL objects, to call while the context is still alive
+    void releaseBuffers();
+
+    // record the trails into a software rasterizer instead, for runs without GL.
+    //      same strips and fade as trailVertexShader.glsl. The points are read from the
+    //      trail arena, so this runs on the simulation thread right after captureTrails
+    void rasterizeTrails(const TrailSnapshot &, SoftwareRasterizer &);
 
 private:
     std::shared_ptr<Shader> shader;
+    std::shared_ptr<TrailArena> trailArena;
+
+    // bound while drawing, core profile needs one even without attributes
+    GLuint VAO = 0;
+
+    // set every frame, resolved once
+    GLint infoBaseLocation = -1;
+
+    // the points of every ring, RGBA32F : x, y, trail length up to the point, unused
+    GLuint historyBuffer = 0;
+    GLuint historyTexture = 0;
+    GLsync historyFence = nullptr; // last draw reading the history
+
+    // the colour of every ring, RGBA32F, only rewritten when a Color changed
+    GLuint colorBuffer = 0;
+    GLuint colorTexture = 0;
+    std::vector<GLfloat> colors;
+
+    // per frame info texel of every ring, streamed. The texture covers the whole
+    //      stream and the shader is given the first texel of the frame's region
+    std::unique_ptr<StreamingBuffer> infoStream;
+    GLuint infoTexture = 0;
+    GLsizeiptr infoRegionSize = 0;
+
+    // number of rings the GPU copy has room for
+    std::uint32_t ringCount = 0;
+
+    // the TrailSnapshot layout the shader and the history were set up for
+    std::uint32_t ringLength = 0;
+    float maxLength = 0.0f;
+
+    // the TrailSnapshot::colorVersion in the colour buffer
+    std::uint64_t uploadedColorVersion = 0;
+
+    // capture side : the members and tick of the last capture, and the colour version
+    std::vector<Entity> capturedEntities;
+    ChangeTick lastCaptureTick = 0;
+    std::uint64_t colorVersion = 0;
+
+    // capture side, per ring : the ray and Trail::total the renderer is known to have.
+    //      Refilled from the snapshot slot at each capture, kept for their storage
+    std::vector<Entity> knownOwners;
+    std::vector<std::uint32_t> knownTotals;
+
+    // first vertex (slot * ringLength) and vertex count of each drawn trail, fed to
+    //      glMultiDrawArrays. Kept as members so their storage is reused frame after frame
+    std::vector<GLint> trailFirsts;
+    std::vector<GLsizei> trailCounts;
+
+    // create the GL objects
+    void setUpTrailBuffers();
+
+    // give the shader the snapshot's ring length and trail length
+    void setLayout(const TrailSnapshot &);
+
+    // reallocate the history and colour buffers for the arena's current ring count,
+    //      keeping the history already on the GPU
+    void growTrailBuffers(const TrailSnapshot &);
+
+    // write the snapshot's new points into the history buffer
+    void uploadNewPoints(const TrailSnapshot &);
+
+    // rewrite the colour buffer if a ray's colour changed
+    void uploadColors(const TrailSnapshot &);
 };
 
-#endif
\ No newline at end of file
+#endif
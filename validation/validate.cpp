@@ -0,0 +1,491 @@
+// accuracy against cost of the lensing integrators. Rays are shot past a single black
+//      hole through LensingSystem::update, for each integrator and several time steps and
+//      substep counts, and the angle each ray sweeps around the hole between entering and leaving a
+//      circle of radius R is compared with the exact Schwarzschild value, an elliptic
+//      integral. The drift of the conserved E and L is tracked along the way.
+//
+//      validate [--output PREFIX] [--tolerance RADIANS]
+//
+//      PREFIX_rays.csv     one row per configuration and impact parameter
+//      PREFIX_configs.csv  one row per configuration : wall time against errors, to plot
+//
+//      The exact asymptotic deflection and the weak-field 2 r_s / b limit are written
+//      next to each ray as references, with the closest approach of its Periapsis event
+//      against the exact one. Captures are the Horizon events. Reduced and Block must stay
+//      within REDUCED_TOLERANCE at every configuration. Last, Block rays refined
+//      during an update are checked to end it where a fine Full integration does
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../components/GravityWell.h"
+#include "../components/Projectile.h"
+#include "../components/Trail.h"
+#include "../components/Transform2D.h"
+#include "../components/Velocity2D.h"
+#include "../core/Coordinator.h"
+#include "../systems/LensingSystem.h"
+
+// the systems reference the global coordinator, like in lensing2d.cpp
+Coordinator coordinator;
+
+// the black hole of lensing2d.cpp
+static const float BLACK_HOLE_MASS = 8.54e36f;
+
+// rays start this many r_s away and are measured when they get as far again
+static const double START_DISTANCE = 200.0;
+
+// impact parameters in r_s, from just above the capture limit 3 sqrt(3) / 2
+static const double IMPACT_PARAMETERS[] = {2.7, 3.0, 3.5, 4.0, 5.0, 7.0, 10.0, 15.0, 20.0, 30.0, 50.0};
+
+// largest sweep error accepted from Reduced and Block at every configuration, without a
+//      capture mismatch. They keep E and L exact, well within it unless the projection
+//      onto the null constraint breaks down
+static const double REDUCED_TOLERANCE = 1e-2;
+
+// an integrator configuration : which integrator, time step per update and RK4 steps per update,
+//      at most with Block
+struct Configuration
+{
+    GeodesicIntegrator integrator;
+    float timeStep;
+    int substeps;
+};
+
+static const char *integratorName(GeodesicIntegrator integrator)
+{
+    switch (integrator)
+    {
+    case GeodesicIntegrator::Reduced: return "reduced";
+    case GeodesicIntegrator::Block: return "block";
+    default: return "full";
+    }
+}
+
+// Carlson's symmetric elliptic integral of the first kind R_F(x, y, z)
+static double carlsonRF(double x, double y, double z)
+{
+    for (int i = 0; i < 64; ++i)
+    {
+        double lambda = std::sqrt(x * y) + std::sqrt(x * z) + std::sqrt(y * z);
+        x = 0.25 * (x + lambda);
+        y = 0.25 * (y + lambda);
+        z = 0.25 * (z + lambda);
+        if (std::fabs(x - y) < 1e-14 * x && std::fabs(x - z) < 1e-14 * x) break;
+    }
+    return 1.0 / std::sqrt((x + y + z) / 3.0);
+}
+
+// exact closest approach of a photon of impact parameter b, in units of r_s : the
+//      largest root of r^3 - b^2 r + b^2 = 0. NaN when the photon is captured
+static double exactPeriapsis(double b)
+{
+    const double criticalB = 1.5 * std::sqrt(3.0);
+    if (b <= criticalB) return NAN;
+    return 2.0 * b / std::sqrt(3.0) * std::cos(std::acos(-1.5 * std::sqrt(3.0) / b) / 3.0);
+}
+
+// exact angle swept around the hole by a photon of impact parameter b between two
+//      crossings of radius R (R = infinity for the asymptotic value), in units of r_s.
+//      With u = 1 / r the orbit is (du/dphi)^2 = 1/b^2 - u^2 + u^3, a cubic with roots
+//      u1 < 0 < u0 < u3 where u0 is the closest approach, so the half orbit
+//      integral from 1/R to u0 of du / sqrt((u - u1)(u0 - u)(u3 - u)) is an elliptic
+//      integral, in Carlson's form. Returns NaN when the photon is captured
+static double exactSweep(double b, double R)
+{
+    double r0 = exactPeriapsis(b);
+    if (std::isnan(r0) || R <= r0) return NAN;
+    double u0 = 1.0 / r0;
+    // the roots sum to 1 and multiply to -1 / b^2
+    double sum = 1.0 - u0;
+    double product = -1.0 / (b * b * u0);
+    double root = std::sqrt(sum * sum - 4.0 * product);
+    double u3 = 0.5 * (sum + root);
+    double u1 = 0.5 * (sum - root);
+
+    double x = u0, y = 1.0 / R;
+    double X1 = std::sqrt(x - u1), X3 = std::sqrt(u3 - x);
+    double Y1 = std::sqrt(y - u1), Y2 = std::sqrt(x - y), Y3 = std::sqrt(u3 - y);
+    double U12 = Y1 * Y2 * X3 / (x - y);
+    double U13 = X1 * X3 * Y2 / (x - y);
+    double U23 = Y2 * Y3 * X1 / (x - y);
+    return 2.0 * 2.0 * carlsonRF(U12 * U12, U13 * U13, U23 * U23);
+}
+
+static double wrapAngle(double angle)
+{
+    while (angle > M_PI) angle -= 2.0 * M_PI;
+    while (angle <= -M_PI) angle += 2.0 * M_PI;
+    return angle;
+}
+
+// photon state around the hole from a Cartesian position and velocity
+static GeodesicState polarState(glm::vec2 position, glm::vec2 velocity, float rs)
+{
+    GeodesicState state{};
+    state.r = glm::length(position);
+    state.phi = std::atan2(position.y, position.x);
+    state.dr = glm::dot(position, velocity) / state.r;
+    state.dphi = (position.x * velocity.y - position.y * velocity.x) / (state.r * state.r);
+    LensingSystem::computeConserved(state, rs);
+    return state;
+}
+
+// what is measured on one ray
+struct RayResult
+{
+    double impactParameter = 0.0; // |L| / E at launch, in r_s
+    double startRadius = 0.0;     // in r_s, the sweep ends back at it
+    double sweep = NAN;           // angle swept until back at the start radius, whichever the side,
+                                  //      NaN if it did not get there
+    bool captured = false;        // a Horizon event
+    double periapsis = NAN;       // distance of the first Periapsis event, in r_s
+    double energyDrift = 0.0;     // largest |E / E0 - 1|
+    double momentumDrift = 0.0;   // largest |L / L0 - 1|
+};
+
+struct ConfigurationResult
+{
+    Configuration configuration;
+    double seconds = 0.0;
+    std::vector<RayResult> rays;
+};
+
+// a fresh world with the black hole at the origin and a LensingSystem set up for the
+//      configuration, returns r_s
+static float createWorld(const Configuration &configuration, std::shared_ptr<LensingSystem> &lensing,
+                         std::shared_ptr<TrailArena> &arena)
+{
+    coordinator.init();
+    coordinator.registerComponent<Transform2D>();
+    coordinator.registerComponent<Velocity2D>();
+    coordinator.registerComponent<GravityWell>();
+    coordinator.registerComponent<Projectile>();
+    coordinator.registerComponent<Trail>();
+    lensing = coordinator.registerSystem<LensingSystem>();
+    {
+        Signature signature;
+        signature.set(coordinator.getComponentType<Transform2D>());
+        coordinator.setSystemSignature<LensingSystem>(signature);
+    }
+    arena = std::make_shared<TrailArena>(2);
+    lensing->setTrailArena(arena);
+    lensing->setSubsteps(configuration.substeps);
+    lensing->setIntegrator(configuration.integrator);
+
+    const float rs = 2.0f * G * BLACK_HOLE_MASS / (c * c);
+    Entity hole = coordinator.createEntity();
+    coordinator.addComponent<Transform2D>(hole, {glm::vec2(0.0f)});
+    coordinator.addComponent<GravityWell>(hole, {BLACK_HOLE_MASS, rs});
+    return rs;
+}
+
+static Entity createRay(glm::vec2 position, glm::vec2 velocity, float b, TrailArena &arena)
+{
+    Entity ray = coordinator.createEntity();
+    coordinator.addComponent<Transform2D>(ray, {position});
+    coordinator.addComponent<Velocity2D>(ray, {velocity});
+    coordinator.addComponent<Projectile>(ray, {b});
+    coordinator.addComponent<Trail>(ray, arena.allocate());
+    return ray;
+}
+
+// one ray per impact parameter, integrated until every ray is out again or captured
+static ConfigurationResult run(const Configuration &configuration)
+{
+    std::shared_ptr<LensingSystem> lensing;
+    std::shared_ptr<TrailArena> arena;
+    const float rs = createWorld(configuration, lensing, arena);
+
+    // each ray starts START_DISTANCE r_s left of the hole, going right at c
+    const size_t rayCount = sizeof(IMPACT_PARAMETERS) / sizeof(IMPACT_PARAMETERS[0]);
+    std::vector<Entity> rays;
+    std::vector<GeodesicState> initial;
+    std::vector<double> swept, previousPhi, previousRadius;
+    std::vector<bool> done(rayCount, false);
+    ConfigurationResult result{configuration, 0.0, std::vector<RayResult>(rayCount)};
+    for (size_t i = 0; i < rayCount; ++i)
+    {
+        glm::vec2 position(-START_DISTANCE * rs, IMPACT_PARAMETERS[i] * rs);
+        glm::vec2 velocity(c, 0.0f);
+        rays.push_back(createRay(position, velocity, static_cast<float>(IMPACT_PARAMETERS[i] * rs), *arena));
+
+        GeodesicState state = polarState(position, velocity, rs);
+        initial.push_back(state);
+        swept.push_back(0.0);
+        previousPhi.push_back(state.phi);
+        previousRadius.push_back(state.r);
+        result.rays[i].impactParameter = std::fabs(state.L) / (state.E * rs);
+        result.rays[i].startRadius = state.r / rs;
+    }
+
+    // a ray goes twice the start distance, give it twice that at the slowest
+    const double flightTime = 2.0 * START_DISTANCE * rs / c;
+    const int maxUpdates = static_cast<int>(2.0 * flightTime / configuration.timeStep);
+    size_t remaining = rayCount;
+    auto start = std::chrono::steady_clock::now();
+    for (int update = 0; update < maxUpdates && remaining > 0; ++update)
+    {
+        lensing->update(configuration.timeStep);
+        for (const RayEvent &event : lensing->getEvents())
+        {
+            size_t i = std::find(rays.begin(), rays.end(), event.ray) - rays.begin();
+            if (i == rayCount || done[i]) continue;
+            if (event.kind == RayEventKind::Horizon) result.rays[i].captured = true;
+            else if (event.kind == RayEventKind::Periapsis && std::isnan(result.rays[i].periapsis))
+            {
+                result.rays[i].periapsis = event.r / rs;
+            }
+        }
+        for (size_t i = 0; i < rayCount; ++i)
+        {
+            if (done[i]) continue;
+            RayResult &ray = result.rays[i];
+            glm::vec2 position = coordinator.getComponent<Transform2D>(rays[i]).position;
+            glm::vec2 velocity = coordinator.getComponent<Velocity2D>(rays[i]).velocity;
+            GeodesicState state = polarState(position, velocity, rs);
+
+            double step = wrapAngle(state.phi - previousPhi[i]);
+            if (ray.captured)
+            {
+                done[i] = true;
+                remaining--;
+                continue;
+            }
+            ray.energyDrift = std::max(ray.energyDrift, std::fabs(state.E / initial[i].E - 1.0));
+            ray.momentumDrift = std::max(ray.momentumDrift, std::fabs(state.L / initial[i].L - 1.0));
+
+            // leaving the start circle : the angle at the crossing, interpolated in r
+            double startRadius = ray.startRadius * rs;
+            if (state.dr > 0.0f && state.r >= startRadius)
+            {
+                double t = (startRadius - previousRadius[i]) / std::max(state.r - previousRadius[i], 1e-30);
+                ray.sweep = std::fabs(swept[i] + std::clamp(t, 0.0, 1.0) * step);
+                done[i] = true;
+                remaining--;
+                continue;
+            }
+            swept[i] += step;
+            previousPhi[i] = state.phi;
+            previousRadius[i] = state.r;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Block steps rays at different levels inside one update : each must still end it at the
+//      same affine time as the others. Rays of impact parameter SYNC_IMPACT_PARAMETER start at
+//      radii from SYNC_RADII, heading in, so some get refined during the update, and after one
+//      update their positions are compared with a finely substepped Full integration. Returns
+//      false on a mismatch
+static const float SYNC_TIME_STEP = 100.0f; // c dt is about 2.4 r_s
+static const int SYNC_SUBSTEPS = 64;
+static const int SYNC_REFERENCE_SUBSTEPS = 1024;
+static const double SYNC_IMPACT_PARAMETER = 5.0;
+static const double SYNC_RADII[] = {5.5, 6.0, 6.5, 7.0, 7.5, 8.0, 9.0, 10.0, 12.0, 15.0, 20.0, 30.0, 50.0, 100.0};
+static const double SYNC_TOLERANCE = 1e-3;
+
+static bool checkBlockSynchronisation()
+{
+    const size_t rayCount = sizeof(SYNC_RADII) / sizeof(SYNC_RADII[0]);
+    std::vector<glm::vec2> endPositions[2];
+    std::vector<glm::vec2> endVelocity; // of the reference
+    std::vector<double> closest(rayCount, INFINITY);
+    float accuracy = 0.0f;
+    float rs = 0.0f;
+    const Configuration configurations[2] = {{GeodesicIntegrator::Full, SYNC_TIME_STEP, SYNC_REFERENCE_SUBSTEPS},
+                                             {GeodesicIntegrator::Block, SYNC_TIME_STEP, SYNC_SUBSTEPS}};
+    for (int k = 0; k < 2; ++k)
+    {
+        std::shared_ptr<LensingSystem> lensing;
+        std::shared_ptr<TrailArena> arena;
+        rs = createWorld(configurations[k], lensing, arena);
+        accuracy = lensing->getStepAccuracy();
+        std::vector<Entity> rays;
+        for (double radius : SYNC_RADII)
+        {
+            double b = SYNC_IMPACT_PARAMETER;
+            glm::vec2 position(-std::sqrt(radius * radius - b * b) * rs, b * rs);
+            rays.push_back(createRay(position, glm::vec2(c, 0.0f), static_cast<float>(b * rs), *arena));
+        }
+        lensing->update(SYNC_TIME_STEP);
+        for (size_t i = 0; i < rayCount; ++i)
+        {
+            endPositions[k].push_back(coordinator.getComponent<Transform2D>(rays[i]).position);
+            if (k == 0) endVelocity.push_back(coordinator.getComponent<Velocity2D>(rays[i]).velocity);
+            closest[i] = std::min(closest[i], double(glm::length(endPositions[k].back())) / rs);
+        }
+        if (k == 0)
+        {
+            for (const RayEvent &event : lensing->getEvents())
+            {
+                size_t i = std::find(rays.begin(), rays.end(), event.ray) - rays.begin();
+                if (i < rayCount && event.kind == RayEventKind::Periapsis) closest[i] = std::min(closest[i], double(event.r) / rs);
+            }
+        }
+    }
+
+    // the level Block wants at a radius, as LensingSystem::blockLevel with E = c
+    auto level = [&](double radius)
+    {
+        int maxLevel = 0;
+        while ((1 << maxLevel) < SYNC_SUBSTEPS) maxLevel++;
+        double length = c * SYNC_TIME_STEP / rs;
+        int result = 0;
+        while (result < maxLevel && length > accuracy * (radius - 1.0))
+        {
+            length *= 0.5;
+            result++;
+        }
+        return result;
+    };
+
+    // the lag along the ray in units of dt and the distance across it in units of c dt
+    std::printf("\nblock synchronisation, time step %g, %d substeps against full %d\n", SYNC_TIME_STEP, SYNC_SUBSTEPS,
+                SYNC_REFERENCE_SUBSTEPS);
+    std::printf("%9s %9s %12s %12s\n", "radius", "refined", "time_lag", "cross_track");
+    bool ok = true;
+    int refined = 0;
+    for (size_t i = 0; i < rayCount; ++i)
+    {
+        double dx = double(endPositions[1][i].x) - endPositions[0][i].x;
+        double dy = double(endPositions[1][i].y) - endPositions[0][i].y;
+        double vx = endVelocity[i].x, vy = endVelocity[i].y;
+        double lag = (dx * vx + dy * vy) / (vx * vx + vy * vy) / SYNC_TIME_STEP;
+        double crossTrack = std::hypot(dx - lag * SYNC_TIME_STEP * vx, dy - lag * SYNC_TIME_STEP * vy) / (c * SYNC_TIME_STEP);
+        bool wasRefined = level(closest[i]) > level(SYNC_RADII[i]);
+        refined += wasRefined ? 1 : 0;
+        ok = ok && std::fabs(lag) < SYNC_TOLERANCE && crossTrack < SYNC_TOLERANCE;
+        std::printf("%9g %9s %12.4g %12.4g\n", SYNC_RADII[i], wasRefined ? "yes" : "no", lag, crossTrack);
+    }
+    // without a refined ray the check proves nothing
+    if (refined == 0) std::printf("no ray refined during the update\n");
+    return ok && refined > 0;
+}
+
+static void printUsage(const char *program)
+{
+    std::cerr << "usage: " << program << " [--output PREFIX] [--tolerance RADIANS]\n"
+              << "  --output PREFIX     PREFIX_rays.csv and PREFIX_configs.csv (default validation)\n"
+              << "  --tolerance R       largest acceptable sweep error, the cheapest configuration\n"
+              << "                      meeting it is reported (default 1e-2)\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string output = "validation";
+    double tolerance = 1e-2;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) output = argv[++i];
+        else if (arg == "--tolerance" && i + 1 < argc) tolerance = std::atof(argv[++i]);
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Configuration> configurations;
+    for (GeodesicIntegrator integrator : {GeodesicIntegrator::Full, GeodesicIntegrator::Reduced, GeodesicIntegrator::Block})
+    {
+        for (float timeStep : {0.75f, 1.5f, 3.0f})
+        {
+            for (int substeps : {1, 2, 4, 8, 16}) configurations.push_back({integrator, timeStep, substeps});
+        }
+    }
+
+    std::string raysPath = output + "_rays.csv";
+    std::string configsPath = output + "_configs.csv";
+    std::FILE *raysFile = std::fopen(raysPath.c_str(), "w");
+    std::FILE *configsFile = std::fopen(configsPath.c_str(), "w");
+    if (!raysFile || !configsFile)
+    {
+        std::cerr << "Failed to open " << raysPath << " or " << configsPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::fprintf(raysFile, "integrator,time_step,substeps,impact_parameter,captured,sweep,exact_sweep,error,"
+                           "exact_deflection,weak_field_deflection,energy_drift,momentum_drift,periapsis,exact_periapsis\n");
+    std::fprintf(configsFile, "integrator,time_step,substeps,wall_seconds,max_error,rms_error,capture_mismatches,"
+                              "max_energy_drift,max_momentum_drift,max_periapsis_error\n");
+
+    std::printf("%10s %9s %9s %12s %12s %12s %8s %12s %12s %12s\n", "integrator", "time_step", "substeps", "wall_s",
+                "max_error", "rms_error", "capture", "E_drift", "L_drift", "periapsis");
+    const ConfigurationResult *cheapest = nullptr;
+    int reducedFailures = 0;
+    std::vector<ConfigurationResult> results;
+    results.reserve(configurations.size());
+    for (const Configuration &configuration : configurations)
+    {
+        results.push_back(run(configuration));
+        const ConfigurationResult &result = results.back();
+
+        double maxError = 0.0, squaredErrors = 0.0, maxEnergyDrift = 0.0, maxMomentumDrift = 0.0, maxPeriapsisError = 0.0;
+        int measured = 0, captureMismatches = 0;
+        for (const RayResult &ray : result.rays)
+        {
+            // the exact value is for the photon actually launched, b = |L| / E
+            double exact = exactSweep(ray.impactParameter, ray.startRadius);
+            double deflection = exactSweep(ray.impactParameter, INFINITY) - M_PI;
+            double error = ray.sweep - exact;
+            double periapsis = exactPeriapsis(ray.impactParameter);
+            if (ray.captured != std::isnan(exact) || (!ray.captured && std::isnan(ray.sweep))) captureMismatches++;
+            else if (!ray.captured)
+            {
+                maxError = std::max(maxError, std::fabs(error));
+                squaredErrors += error * error;
+                measured++;
+                // a missing Periapsis event counts as an infinite error
+                maxPeriapsisError = std::max(maxPeriapsisError, std::isnan(ray.periapsis) ? INFINITY : std::fabs(ray.periapsis - periapsis));
+            }
+            maxEnergyDrift = std::max(maxEnergyDrift, ray.energyDrift);
+            maxMomentumDrift = std::max(maxMomentumDrift, ray.momentumDrift);
+            std::fprintf(raysFile, "%s,%g,%d,%.9g,%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+                         integratorName(configuration.integrator), configuration.timeStep, configuration.substeps,
+                         ray.impactParameter, ray.captured ? 1 : 0, ray.sweep, exact, error, deflection,
+                         2.0 / ray.impactParameter, ray.energyDrift, ray.momentumDrift, ray.periapsis, periapsis);
+        }
+        double rmsError = measured > 0 ? std::sqrt(squaredErrors / measured) : NAN;
+        std::fprintf(configsFile, "%s,%g,%d,%.6g,%.9g,%.9g,%d,%.9g,%.9g,%.9g\n", integratorName(configuration.integrator),
+                     configuration.timeStep, configuration.substeps, result.seconds, maxError, rmsError,
+                     captureMismatches, maxEnergyDrift, maxMomentumDrift, maxPeriapsisError);
+        std::printf("%10s %9g %9d %12.4g %12.4g %12.4g %8d %12.4g %12.4g %12.4g\n", integratorName(configuration.integrator),
+                    configuration.timeStep, configuration.substeps, result.seconds, maxError, rmsError,
+                    captureMismatches, maxEnergyDrift, maxMomentumDrift, maxPeriapsisError);
+
+        bool acceptable = captureMismatches == 0 && maxError <= tolerance;
+        if (acceptable && (!cheapest || result.seconds < cheapest->seconds)) cheapest = &result;
+        if (configuration.integrator != GeodesicIntegrator::Full
+            && (captureMismatches > 0 || !(maxError <= REDUCED_TOLERANCE)))
+        {
+            reducedFailures++;
+        }
+    }
+    std::fclose(raysFile);
+    std::fclose(configsFile);
+
+    if (cheapest)
+    {
+        std::printf("cheapest configuration within %g rad : %s integrator, time step %g, %d substeps (%.3g s)\n",
+                    tolerance, integratorName(cheapest->configuration.integrator), cheapest->configuration.timeStep, cheapest->configuration.substeps, cheapest->seconds);
+    }
+    else
+    {
+        std::printf("no configuration within %g rad\n", tolerance);
+    }
+    if (reducedFailures > 0)
+    {
+        std::printf("%d reduced or block configurations beyond %g rad or with a capture mismatch\n", reducedFailures,
+                    REDUCED_TOLERANCE);
+    }
+    bool synchronised = checkBlockSynchronisation();
+    return cheapest && reducedFailures == 0 && synchronised ? EXIT_SUCCESS : EXIT_FAILURE;
+}